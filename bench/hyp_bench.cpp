@@ -0,0 +1,360 @@
+/** @file hyp_bench.cpp
+  * @brief times every stage of the pipeline, alone, on synthetic frames.
+  */
+
+#include <HYP.hpp>
+#include <green_classifier.hpp>
+#include <incremental_mask.hpp>
+
+#include <unistd.h> // getopt
+#include <cstdio>
+#include <cmath>
+
+//--MACROS----------------------------------------------------
+#define DEFAULT_REPEATS		20
+#define SEGMENT_POINTS		100000	// points measured against a segment, per repeat
+#define BACKGROUND		Scalar(90, 60, 140)
+#define CARD_GREEN		Scalar(40, 200, 40)
+#define MOVING_SIDE		64	// side of the square that changes between frames of the incremental mask
+
+using namespace std;
+using namespace cv;
+
+/*---------------------------------
+  FLAGS AND CONSTRAITS
+  ---------------------------------*/
+int repeats = DEFAULT_REPEATS;
+bool quick = false;	// only the smallest case of every sweep
+const GreenClassifier* generic = NULL;	// the default thresholds, without the kernels of their preset
+
+//! One point of the sweep.
+struct Scene {
+	Size size;
+	int quads;	// green quadrilaterals in the frame
+	float side;	// side of the quadrilaterals, relative to the frame height
+	int noise;	// amplitude of the noise added to every channel
+};
+
+//! Timings of one stage over the repeats, in milliseconds.
+struct Stats {
+	double min, median, mean, stddev;
+};
+
+/** @fn Mat make_frame ( const Scene& scene, RNG& rng )
+  *
+  * @brief	A frame with `scene.quads` green quadrilaterals, turned and
+  *		a bit skewed, over a flat background with uniform noise.
+  */
+Mat make_frame ( const Scene& scene, RNG& rng ){
+	Mat frame ( scene.size, CV_8UC3, BACKGROUND );
+	const float side = scene.side * scene.size.height;
+
+	for ( int i=0; i<scene.quads; i++ ){
+		Point2f c ( rng.uniform( side, scene.size.width - side ), rng.uniform( side, scene.size.height - side ) );
+		float angle = rng.uniform( 0.f, (float) CV_PI );
+
+		Point corners[4];
+		for ( int k=0; k<4; k++ ){
+			float a = angle + k * (float) CV_PI / 2 + rng.uniform( -0.15f, 0.15f );
+			float r = side / sqrt(2.f) * rng.uniform( 0.85f, 1.15f );
+			corners[k] = Point( c.x + r*cos(a), c.y + r*sin(a) );
+		}
+		fillConvexPoly( frame, corners, 4, CARD_GREEN );
+	}
+
+	if( scene.noise ){
+		Mat up ( frame.size(), frame.type() ), down ( frame.size(), frame.type() );
+		randu( up, Scalar::all(0), Scalar::all(scene.noise) );
+		randu( down, Scalar::all(0), Scalar::all(scene.noise) );
+		add( frame, up, frame );
+		subtract( frame, down, frame );
+	}
+
+	return frame;
+}
+
+/** @fn Mat make_nv12 ( const Mat& frame )
+  *
+  * @brief	`frame` as a decoder would give it in NV12: BT.601 with
+  *		video range, the chroma of the top left pixel of every 2x2.
+  */
+Mat make_nv12 ( const Mat& frame ){
+	Mat nv12 ( frame.rows * 3 / 2, frame.cols, CV_8UC1 );
+
+	for ( int y=0; y<frame.rows; y++ ){
+		const uchar* p = frame.ptr<uchar>(y);
+		uchar* luma = nv12.ptr<uchar>(y);
+		uchar* chroma = nv12.ptr<uchar>(frame.rows + y/2);
+
+		for ( int x=0; x<frame.cols; x++, p += 3 ){
+			const int b = p[0], g = p[1], r = p[2];
+			luma[x] = saturate_cast<uchar>( ( ( 66*r + 129*g + 25*b + 128 ) >> 8 ) + 16 );
+			if( y % 2 == 0 && x % 2 == 0 ){
+				chroma[x]     = saturate_cast<uchar>( ( ( -38*r - 74*g + 112*b + 128 ) >> 8 ) + 128 );
+				chroma[x + 1] = saturate_cast<uchar>( ( ( 112*r - 94*g - 18*b + 128 ) >> 8 ) + 128 );
+			}
+		}
+	}
+
+	return nv12;
+}
+
+/** @fn Stats measure ( Prepare prepare, Run run )
+  *
+  * @brief	Calls prepare() and then run() `repeats` times, timing only run().
+  */
+template <typename Prepare, typename Run>
+Stats measure ( Prepare prepare, Run run ){
+	vector<double> ms;
+	for ( int i=0; i<repeats; i++ ){
+		prepare();
+		int64 start = getTickCount();
+		run();
+		ms.push_back( (getTickCount() - start) * 1000. / getTickFrequency() );
+	}
+
+	Stats s;
+	sort( ms.begin(), ms.end() );
+	s.min = ms.front();
+	s.median = ms.size() % 2 ? ms[ms.size()/2] : ( ms[ms.size()/2 - 1] + ms[ms.size()/2] ) / 2;
+
+	s.mean = 0;
+	for ( size_t i=0; i<ms.size(); i++ )
+		s.mean += ms[i];
+	s.mean /= ms.size();
+
+	s.stddev = 0;
+	for ( size_t i=0; i<ms.size(); i++ )
+		s.stddev += ( ms[i] - s.mean ) * ( ms[i] - s.mean );
+	s.stddev = sqrt( s.stddev / ms.size() );
+
+	return s;
+}
+
+void report ( const Scene& scene, const char* stage, const Stats& s ){
+	printf( "%dx%d,%d,%.2f,%d,%s,%.4f,%.4f,%.4f,%.4f\n",
+		scene.size.width, scene.size.height, scene.quads, scene.side, scene.noise,
+		stage, s.min, s.median, s.mean, s.stddev );
+	fflush( stdout );
+}
+
+/** @fn void bench_scene ( const Scene& scene )
+  *
+  * @brief	Every stage on the same frame. The input of each stage comes
+  *		from the stages before it, made outside of the timing.
+  */
+void bench_scene ( const Scene& scene ){
+	RNG rng ( 0x4859 );
+	Mat frame = make_frame( scene, rng );
+	Mat past = make_frame( scene, rng );
+
+	// best_green
+	Mat green;
+	report( scene, "best_green", measure( [](){}, [&](){ green = best_green( frame ); } ) );
+
+	// The median blur of the classes, in bytes as it was and in bits
+	{
+		Mat classes ( frame.size(), CV_8UC1 ), median;
+		report( scene, "classify_preset", measure( [](){}, [&](){ GreenClassifier::get().classify( frame, classes ); } ) );
+		report( scene, "classify_generic", measure( [](){}, [&](){ generic->classify( frame, classes ); } ) );
+		report( scene, "medianBlur", measure( [](){}, [&](){ medianBlur( classes, median, BGREEN_MEDIAN_BLUR_WIN ); } ) );
+
+		BitMask bits, bits_median;
+		report( scene, "classify_bits", measure( [](){}, [&](){ GreenClassifier::get().classify( frame, bits ); } ) );
+
+		// The same frame as decoded in NV12: no conversion to BGR first
+		Mat nv12 = make_nv12( frame );
+		GreenClassifier::get().classify_nv12( nv12, bits );	// builds its table
+		report( scene, "classify_nv12", measure( [](){}, [&](){ GreenClassifier::get().classify_nv12( nv12, bits ); } ) );
+
+		bits.pack( classes );
+		report( scene, "bit_median", measure( [](){}, [&](){ bit_median( bits, bits_median, BGREEN_MEDIAN_BLUR_WIN ); } ) );
+	}
+
+	// IncrementalMask::update, a fixed camera with a small square that
+	// comes and goes: every update sees it appear or disappear
+	{
+		Mat moved = frame.clone();
+		Mat(moved, Rect( Point( moved.cols/2, moved.rows/2 ), Size( MOVING_SIDE, MOVING_SIDE ) ) & Rect( Point(0, 0), moved.size() ))
+			.setTo( CARD_GREEN );
+
+		IncrementalMask incremental;
+		incremental.update( frame );
+
+		int n = 0;
+		const Mat* next = &frame;
+		report( scene, "incremental_mask", measure(
+			[&](){ next = ( n++ % 2 ) ? &frame : &moved; },
+			[&](){ incremental.update( *next ); } ) );
+	}
+
+	// find_connected_components: it paints the mask, so a new copy every time
+	Mat labeled;
+	vector<Blob> blobs;
+	report( scene, "find_connected_components", measure(
+		[&](){ green.copyTo( labeled ); },
+		[&](){ find_connected_components( labeled, blobs ); } ) );
+
+	// extend_and_group_bounding_rects
+	vector<Rect> rects, roi;
+	labeled = green.clone();
+	find_connected_components( labeled, rects );
+	report( scene, "extend_and_group_bounding_rects", measure(
+		[&](){ roi = rects; },
+		[&](){ extend_and_group_bounding_rects( roi, frame.size() ); } ) );
+
+	// findContours, in every ROI
+	vector< vector<Point> > curves;
+	{
+		Mat contours;
+		vector< vector<Point> > roi_curves;
+		vector<Vec4i> hierarchy;
+		report( scene, "findContours", measure( [&](){ curves.clear(); }, [&](){
+			for ( size_t i=0; i<roi.size(); i++ ){
+				Mat(labeled, roi[i]).copyTo( contours );
+				findContours( contours, roi_curves, hierarchy, RETR_TREE, CHAIN_APPROX_SIMPLE );
+				curves.insert( curves.end(), roi_curves.begin(), roi_curves.end() );
+			}
+		} ) );
+	}
+
+	// approximate_quadrilateral, on every curve
+	QuadScratch scratch;
+	vector<Quadrilateral> quads;
+	report( scene, "approximate_quadrilateral", measure( [&](){ quads.clear(); }, [&](){
+		for ( size_t i=0; i<curves.size(); i++ ){
+			if( curves[i].size() < 4 ) continue;
+			Quadrilateral q;
+			approximate_quadrilateral( curves[i], q, scratch.rdp );
+			quads.push_back( q );
+		}
+	} ) );
+
+	// LineSegment2d::shortestDistanceTo, random points against one segment, one by one
+	{
+		vector<Point2f> points ( SEGMENT_POINTS );
+		for ( size_t i=0; i<points.size(); i++ )
+			points[i] = Point2f( rng.uniform( 0, frame.cols ), rng.uniform( 0, frame.rows ) );
+		LineSegment2d line ( Point2f( frame.cols * .2f, frame.rows * .3f ), Point2f( frame.cols * .7f, frame.rows * .6f ) );
+
+		volatile float sink = 0;
+		report( scene, "shortestDistanceTo", measure( [](){}, [&](){
+			float sum = 0;
+			for ( size_t i=0; i<points.size(); i++ )
+				sum += line.shortestDistanceTo( points[i] );
+			sink = sum;
+		} ) );
+
+		// The same points as separate x and y arrays, all at once
+		vector<float> xs ( points.size() ), ys ( points.size() ), dist ( points.size() );
+		for ( size_t i=0; i<points.size(); i++ ){
+			xs[i] = points[i].x;
+			ys[i] = points[i].y;
+		}
+		report( scene, "shortestDistancesTo", measure( [](){}, [&](){
+			line.shortestDistancesTo( &xs[0], &ys[0], xs.size(), &dist[0] );
+			sink = dist.back();
+		} ) );
+		report( scene, "farthestOf", measure( [](){}, [&](){
+			float d;
+			line.farthestOf( &xs[0], &ys[0], xs.size(), &d );
+			sink = d;
+		} ) );
+		(void) sink;
+	}
+
+	// LineSegment2i::scaledDistanceTo, the farthest of the same points, in integers
+	{
+		vector<Point> points ( SEGMENT_POINTS );
+		for ( size_t i=0; i<points.size(); i++ )
+			points[i] = Point( rng.uniform( 0, frame.cols ), rng.uniform( 0, frame.rows ) );
+		LineSegment2i line ( Point( frame.cols * .2f, frame.rows * .3f ), Point( frame.cols * .7f, frame.rows * .6f ) );
+
+		volatile float sink = 0;
+		report( scene, "scaledDistanceTo", measure( [](){}, [&](){
+			int64 farthest = 0;
+			for ( size_t i=0; i<points.size(); i++ )
+				farthest = max( farthest, line.scaledDistanceTo( points[i] ) );
+			sink = line.distanceFromScaled( farthest );
+		} ) );
+		(void) sink;
+	}
+
+	// replace_quadrilaterals_by_image, every ROI
+	{
+		vector< vector<Quadrilateral> > in_roi ( roi.size() );
+		for ( size_t i=0; i<roi.size(); i++ ){
+			Mat contours = Mat(labeled, roi[i]).clone();
+			get_good_quadrilaterals( contours, in_roi[i], scratch );
+		}
+
+		Mat output;
+		report( scene, "replace_quadrilaterals_by_image", measure(
+			[&](){ frame.copyTo( output ); },
+			[&](){
+				for ( size_t i=0; i<roi.size(); i++ ){
+					Mat out_roi = Mat(output, roi[i]);
+					replace_quadrilaterals_by_image( out_roi, past, Mat(labeled, roi[i]), in_roi[i] );
+				}
+			} ) );
+
+		// Every quadrilateral in one ROI, the whole frame, as when the
+		// cards are close enough for their ROIs to be merged
+		vector<Quadrilateral> merged;
+		for ( size_t i=0; i<roi.size(); i++ )
+			for ( size_t j=0; j<in_roi[i].size(); j++ ){
+				Quadrilateral q = in_roi[i][j];
+				for ( size_t k=0; k<q.size(); k++ )
+					q[k] += roi[i].tl();
+				merged.push_back( q );
+			}
+
+		report( scene, "replace_merged_roi", measure(
+			[&](){ frame.copyTo( output ); },
+			[&](){ replace_quadrilaterals_by_image( output, past, labeled, merged ); } ) );
+	}
+}
+
+void usage( const char* bin ){
+	cerr	<< "usage: " << bin << " [-r repeats] [-q]" << endl
+		<< "  -r repeats times every stage runs in every scene (default " << DEFAULT_REPEATS << ")" << endl
+		<< "  -q         quick: only the first value of every sweep but the resolution" << endl;
+}
+
+int main( int argc, char* argv[] ){
+	int opt;
+	while( (opt = getopt( argc, argv, "r:qh" )) != -1 ){
+		switch( opt ){
+			case 'r':
+				repeats = max( atoi( optarg ), 1 );
+				break;
+			case 'q':
+				quick = true;
+				break;
+			default:
+				usage( argv[0] );
+				exit( opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE );
+		}
+	}
+
+	const Size sizes[] = { Size(640, 480), Size(1280, 720), Size(1920, 1080), Size(3840, 2160) };
+	const int quads[] = { 1, 4, 16 };
+	const float sides[] = { 0.1f, 0.3f };
+	const int noises[] = { 0, 24 };
+
+	// The tables are built before the first frame, as in the application
+	GreenClassifier::get();
+	GreenClassifier generic_classifier ( GreenThresholds(), GREEN_KERNEL_AVX2, false );
+	generic = &generic_classifier;
+
+	printf( "resolution,quads,side,noise,stage,min_ms,median_ms,mean_ms,stddev_ms\n" );
+	for ( size_t r=0; r<sizeof(sizes)/sizeof(*sizes); r++ )
+	for ( size_t q=0; q<(quick ? 1 : sizeof(quads)/sizeof(*quads)); q++ )
+	for ( size_t s=0; s<(quick ? 1 : sizeof(sides)/sizeof(*sides)); s++ )
+	for ( size_t n=0; n<(quick ? 1 : sizeof(noises)/sizeof(*noises)); n++ ){
+		Scene scene = { sizes[r], quads[q], sides[s], noises[n] };
+		bench_scene( scene );
+	}
+
+	return 0;
+}
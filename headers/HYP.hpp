@@ -17,9 +17,20 @@
 // DEBUG
 #include <debug.hpp>
 
+// connected components
+#include <labeler.hpp>
+
+// one bit per pixel masks
+#include <bit_mask.hpp>
+
 // thanks to prof. Bogdan T. Nassu - nassubt-ufpr@yahoo.com.br
 #include <line2d.h>
 
+//! Window of the median blur of the green mask.
+#define BGREEN_MEDIAN_BLUR_WIN 	9  //9
+//! Side of the dilation after it, anchored at its center.
+#define BGREEN_DILATE_SIZE	2
+
 /** @namespace Color
   * Types of color, for indexing in cv::Mat
   */
@@ -54,16 +65,43 @@ public:
 	}
 };
 
+//! Buffers of the RDP scoring, kept between curves to not allocate for every one.
+struct RDPScratch {
+	std::vector<float> score;	// score of every point of the curve
+	std::vector<cv::Vec2i> stack;	// pieces of the curve still to split
+};
+
+//! Buffers of best_green, kept between frames to not allocate for every one.
+struct GreenScratch {
+	BitMask green;	// the classes, then the dilation
+	BitMask blur;	// their median
+};
+
+//! Buffers of get_good_quadrilaterals, kept between calls to not allocate for every ROI.
+struct QuadScratch {
+	std::vector< std::vector<cv::Point> > curves;	// of findContours
+	std::vector<cv::Vec4i> hierarchy;
+	RDPScratch rdp;
+};
+
 /*---------------------------------
   PROTÓTIPOS
   ---------------------------------*/
 cv::Mat	best_green ( const cv::Mat& frame ); //HYP
-void 	get_good_quadrilaterals (cv::Mat& img, std::vector<Quadrilateral>& quadrilateral);
+void	best_green ( const cv::Mat& frame, cv::Mat& mask, GreenScratch& scratch ); //HYP
+void	best_green_nv12 ( const cv::Mat& nv12, cv::Mat& mask, GreenScratch& scratch ); //HYP
+void	smooth_green ( cv::Mat& mask, GreenScratch& scratch ); //HYP
+cv::Mat	grow ( cv::Mat& storage, cv::Size size, int type );
+void 	approximate_quadrilateral ( const std::vector<cv::Point>& curve, Quadrilateral& q, RDPScratch& scratch );
+void 	get_good_quadrilaterals (cv::Mat& img, std::vector<Quadrilateral>& quadrilateral, QuadScratch& scratch, int scale = 1);
+void 	refine_quadrilateral ( const cv::Mat& mask, Quadrilateral& q, int radius );
 void 	draw_point ( cv::Mat& img, std::vector<Quadrilateral>& vec ); //HYP
 void 	draw_point ( cv::Mat& img, std::vector<cv::Point>& vec, cv::Scalar s = cv::Scalar(255,0,255)); //HYP
 void 	mask ( const cv::Mat& src, cv::Mat &dst, const cv::Mat& mask );	//HYP
-void 	replace_quadrilateral_by_image ( cv::Mat& original, cv::Mat& image_to_put, cv::Mat& mask, Quadrilateral &q );
+void 	replace_quadrilateral_by_image ( cv::Mat& original, const cv::Mat& image_to_put, const cv::Mat& mask, Quadrilateral &q );
+void 	replace_quadrilaterals_by_image ( cv::Mat& original, const cv::Mat& image_to_put, const cv::Mat& mask, std::vector<Quadrilateral>& q );
 void 	extend_and_group_bounding_rects (std::vector <cv::Rect>& rects, cv::Size size);
-void 	find_connected_components (cv::Mat& img, std::vector <cv::Rect>& out);
+void 	find_connected_components (cv::Mat& img, std::vector <cv::Rect>& out, int scale = 1);
+void 	find_connected_components (cv::Mat& img, std::vector <Blob>& out);
 
 #endif //_HYP_HPP_
@@ -0,0 +1,89 @@
+/** @file async_writer.hpp
+  * @brief writes frames to disk in a thread of its own, from a bounded set of buffers.
+  */
+
+#ifndef _ASYNC_WRITER_HPP_
+#define _ASYNC_WRITER_HPP_
+
+// std includes
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// opencv
+#include <opencv2/core/core.hpp>
+
+//! Frames copied and waiting to be written, when nothing else is asked.
+#define ASYNC_WRITER_DEFAULT_DEPTH	8
+//! Buffers only a WAIT job may take, so a snapshot never waits for a recording.
+#define ASYNC_WRITER_RESERVE		1
+
+/** @class AsyncWriter
+  *
+  * @brief Copies frames into buffers of its own and gives them, in
+  *	  order, to the jobs that write them, in one thread of its own.
+  *
+  * The thread that submits only pays for the copy: encoding and disk
+  * are the writer's. There are `depth` buffers, allocated on the first
+  * frames and reused after; with none idle, a DROP job is dropped and
+  * counted and a WAIT job waits for the writer. DROP jobs leave
+  * ASYNC_WRITER_RESERVE buffers to the WAIT ones, so a snapshot in the
+  * middle of a recording that fell behind waits for one frame at most.
+  */
+class AsyncWriter {
+public:
+	//! Writes a frame, in the thread of the writer.
+	typedef std::function<void (const cv::Mat& frame)> Job;
+
+	//! What to do when every buffer is in use.
+	typedef enum{ DROP, WAIT } Policy;
+
+	AsyncWriter ( size_t depth = ASYNC_WRITER_DEFAULT_DEPTH );
+	~AsyncWriter ();
+
+	bool	submit ( const cv::Mat& frame, const Job& job, Policy policy = DROP );
+	void	flush ();
+
+	//! Frames given to their jobs.
+	size_t written () const {
+		std::lock_guard<std::mutex> guard ( lock );
+		return n_written;
+	}
+
+	//! DROP jobs dropped for lack of a buffer.
+	size_t dropped () const {
+		std::lock_guard<std::mutex> guard ( lock );
+		return n_dropped;
+	}
+
+private:
+	struct Buffer {
+		cv::Mat frame;
+		Job job;
+	};
+
+	std::vector<Buffer> buffers;
+	std::vector<size_t> idle;	// buffers nobody uses
+	std::vector<size_t> queue;	// buffers to write, in a ring of `depth`
+	size_t first;		// of the queue
+	size_t count;		// in the queue
+	bool busy;		// the writer has a buffer out of the queue
+	bool stopping;
+
+	size_t n_written, n_dropped;
+
+	mutable std::mutex lock;
+	std::condition_variable ready;	// something in the queue, or stopping
+	std::condition_variable done;	// a buffer came back
+
+	std::thread thread;
+
+	void	run ();
+
+	AsyncWriter ( const AsyncWriter& );
+	AsyncWriter& operator= ( const AsyncWriter& );
+};
+
+#endif //_ASYNC_WRITER_HPP_
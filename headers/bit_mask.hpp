@@ -0,0 +1,75 @@
+/** @file bit_mask.hpp
+  * @brief binary mask with one bit per pixel, and its median blur and dilation on whole words.
+  */
+
+#ifndef _BIT_MASK_HPP_
+#define _BIT_MASK_HPP_
+
+// std includes
+#include <vector>
+#include <stdint.h>
+
+// opencv
+#include <opencv2/core/core.hpp>
+
+//! Pixels in a word of a BitMask.
+#define BIT_MASK_WORD 64
+//! Widest window of bit_median(), so its counts fit the bit planes.
+#define BIT_MASK_MAX_WINDOW 63
+
+/** @class BitMask
+  *
+  * @brief Binary image, 64 pixels per 64 bits word: the pixel x of a row
+  *	  is the bit x%64 of its word x/64.
+  *
+  * A mask of 0 and 255 is read 8 times less bytes this way, and the
+  * morphology works on 64 pixels at a time with shifts and logic. The
+  * bits past the width, in the last word of a row, are undefined.
+  */
+class BitMask {
+public:
+	BitMask () : width ( 0 ), height ( 0 ), stride ( 0 ){
+	}
+
+	void create ( cv::Size size );
+
+	cv::Size size () const {
+		return cv::Size( width, height );
+	}
+
+	//! Words of a row.
+	int words () const {
+		return stride;
+	}
+
+	uint64_t* row ( int y ){
+		return &bits[ (size_t) y * stride ];
+	}
+
+	const uint64_t* row ( int y ) const {
+		return &bits[ (size_t) y * stride ];
+	}
+
+	bool get ( int x, int y ) const {
+		return ( row(y)[ x / BIT_MASK_WORD ] >> ( x % BIT_MASK_WORD ) ) & 1;
+	}
+
+	void pack ( const cv::Mat& mask );
+	void unpack ( cv::Mat& mask, uchar one = 255 ) const;
+	void unpack ( cv::Mat& mask, cv::Rect area, uchar one = 255 ) const;
+
+private:
+	int width, height;
+	int stride;	// words per row
+	std::vector<uint64_t> bits;	// only grows
+};
+
+/*---------------------------------
+  PROTÓTIPOS
+  ---------------------------------*/
+void	pack_row ( const uchar* src, uint64_t* dst, int n );
+void	unpack_row ( const uint64_t* src, uchar* dst, int n, uchar one );
+void	bit_median ( const BitMask& src, BitMask& dst, int window, cv::Rect area = cv::Rect() );
+void	bit_dilate ( const BitMask& src, BitMask& dst, int size, cv::Rect area = cv::Rect() );
+
+#endif //_BIT_MASK_HPP_
@@ -3,116 +3,61 @@
 ==================
 Author: Gustavo Yudi Bientinezi Matsuzake (Helped by the internet)
 
-Compile with -DDEBUG or define a DEBUG macro (#define DEBUG)
+Compile with -DDEBUG_LEVEL=N to log the DEBUG messages up to level N
+(-1 for all of them). -DNDEBUG=N still works the same way.
 */
 
 #ifndef _DEBUG_H_
 #define _DEBUG_H_
-#include <sstream>
-#include <iostream>
+#include <climits>
+#include <logger.hpp>
 
 using namespace std;
 
 /*	MACROS	*/
+
 /*
-COLORS
+LEVEL
 =============================
-Implements some MACROS colors
-and MACROS flags for fabulous
-colorized DEBUG messages */
-
-//colors
-#define _NONE	"\033[0m"
-#define _GRAY	"\033[38;5;247m"
-#define _RED	"\033[1;31m"
-#define _GREEN	"\033[1;32m"
-#define _YELLOW	"\033[1;33m"
-#define _BLUE	"\033[38;5;26m"
-
-//functions
-#ifdef DEBUG_COLOR_ENABLE
-	#define GRAY(X)		_GRAY << X << _NONE
-	#define RED(X)		_RED << X << _NONE
-	#define GREEN(X)	_GREEN << X << _NONE
-	#define YELLOW(X)	_YELLOW << X << _NONE
-	#define BLUE(X)		_BLUE << X << _NONE
-#else
-	#define GRAY(X) X 
-	#define RED(X) X
-	#define GREEN(X) X
-	#define YELLOW(X) X
-	#define BLUE(X) X
+The highest level logged, fixed
+when compiling. */
+#if !defined(DEBUG_LEVEL) && defined(NDEBUG)
+	#define DEBUG_LEVEL NDEBUG
 #endif
 
-/*STRINGIFY*/
-#define STR(X) #X
-
-
-/* MACRO FUNCTION TO_STRING (X)
-=============================
-To do something like that:
-
-DEBUG("i = " << i);
-
-*/
-#define TO_STRING( x ) dynamic_cast< std::ostringstream & >( \
-        ( std::ostringstream() << std::dec << x ) ).str()
+#if defined(DEBUG_LEVEL) && DEBUG_LEVEL < 0
+	#undef DEBUG_LEVEL
+	#define DEBUG_LEVEL INT_MAX
+#endif
 
 /*
-MACRO FUNCTION DEBUG(X)
+MACRO FUNCTION DEBUG(X, Y)
 =======================
-call debug(string func, string msg) function, where:
-func - name function
-msg  - debug message
+Logs X at the level Y, where:
+X - debug message, anything that goes in a stream:
+
+DEBUG("i = " << i, 3);
+
+Y - level, a constant
 
-This MACRO calls the debug() with the macro __PRETTY_FUNCTION__ that returns the name of the function.
+The message is formatted in a fixed size record, with the name of the
+function from __PRETTY_FUNCTION__, and pushed to a lock free ring that a
+thread writes to the standard output (see logger.hpp): it never waits
+for the output. A level above DEBUG_LEVEL is a constant false `if`, so
+the compiler removes it; without DEBUG_LEVEL no code at all is produced.
 */
 
-#ifdef NDEBUG
-	#if NDEBUG < 0
-		#define DEBUG(X, Y) debug(__PRETTY_FUNCTION__, TO_STRING(X), Y)
-	#else
-		#define DEBUG(X, Y) if(Y <= NDEBUG) debug(__PRETTY_FUNCTION__, TO_STRING(X), Y)
-	#endif
+#ifdef DEBUG_LEVEL
+	#define DEBUG(X, Y) do{ \
+		if( (Y) <= DEBUG_LEVEL ){ \
+			LogLine _debug_line ( __PRETTY_FUNCTION__, (Y) ); \
+			_debug_line.stream() << X; \
+		} \
+	}while(0)
 #else
-	/*if the MACRO DEBUG isn't defined the DEBUG(X) MACRO
+	/*if the MACRO DEBUG_LEVEL isn't defined the DEBUG(X, Y) MACRO
 	  will not produce any code*/
 	#define DEBUG(X, Y)
 #endif
 
-/*	FUNCTIONS 	*/
-
-void inline debug(string f, string msg, unsigned int n){
-	//prefix
-	#ifdef DEBUG_PREFIX_ENABLE
-		cout << RED("DEBUG")":";
-	#endif
-	
-	//depth
-	cout << "(" << YELLOW(n) << ")";
-
-	//indent
-	for(unsigned int i=0; i<(n*2); i++) cout << ' ';
-
-	//function name and message
-	cout << BLUE(f) << ": " << GRAY(msg) << endl;
-}
-
-//undef colors
-#undef NONE	
-#undef GRAY	
-#undef RED
-#undef GREEN	
-#undef YELLOW	
-#undef BLUE	
-#undef _NONE	
-#undef _GRAY	
-#undef _RED
-#undef _GREEN	
-#undef _YELLOW	
-#undef _BLUE	
-
-//undef strigify
-#undef STR
-
 #endif //_DEBUG_H_
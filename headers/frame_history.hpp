@@ -0,0 +1,64 @@
+/** @file frame_history.hpp
+  * @brief the processed frames of the past, shared with the frame ring instead of copied.
+  */
+
+#ifndef _FRAME_HISTORY_HPP_
+#define _FRAME_HISTORY_HPP_
+
+// std includes
+#include <deque>
+#include <vector>
+#include <mutex>
+
+// opencv
+#include <opencv2/core/core.hpp>
+
+//--MACROS----------------------------------------------------
+#define FRAME_HISTORY_DEFAULT_DELAY	1	// the frame right before
+#define FRAME_HISTORY_SMALL_SCALE	2	// entries over the budget are kept this much smaller
+
+/** @class FrameHistory
+  *
+  * @brief The last processed frames, newest first.
+  *
+  * A frame is pushed by reference: the entry and the ring slot share
+  * the buffer, so nothing is copied. Before the capture reads into a
+  * slot it calls take(), that gives the slot a buffer that left the
+  * history. So every buffer goes around from the capture to the history
+  * and back, and is only written by the capture. The oldest entries are
+  * kept while the output may still use them, that is, while they are
+  * among the last `in_flight` frames.
+  *
+  * With a memory budget, the entries that do not fit in it at full size
+  * are kept FRAME_HISTORY_SMALL_SCALE times smaller, and their buffer
+  * goes back to the capture. Only the entries older than `in_flight`
+  * are made smaller.
+  */
+class FrameHistory {
+public:
+	FrameHistory ( size_t delay, size_t in_flight, size_t budget = 0 );
+
+	void	take ( cv::Mat& frame );
+	void	push ( const cv::Mat& frame );
+	cv::Mat	past ();
+
+	//! How many frames ago is the past.
+	size_t delay () const {
+		return past_delay;
+	}
+
+private:
+	std::deque<cv::Mat> entries;		// newest first
+	std::vector<cv::Mat> free_full;		// buffers that left the history
+	std::vector<cv::Mat> free_small;
+
+	size_t past_delay;
+	size_t in_flight;
+	size_t budget;	// bytes, 0 for no limit
+	size_t keep;	// entries kept
+	size_t full;	// how many of the newest entries are full size
+
+	std::mutex lock;
+};
+
+#endif //_FRAME_HISTORY_HPP_
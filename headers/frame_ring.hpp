@@ -0,0 +1,73 @@
+/** @file frame_ring.hpp
+  * @brief bounded ring of preallocated frames shared by the capture, processing and output threads.
+  */
+
+#ifndef _FRAME_RING_HPP_
+#define _FRAME_RING_HPP_
+
+// std includes
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+// opencv
+#include <opencv2/core/core.hpp>
+
+//! Default number of slots of the ring.
+#define FRAME_RING_DEFAULT_DEPTH 3
+
+/** @namespace Stage
+  * The stages that every frame goes through, in order.
+  */
+namespace Stage{
+	typedef enum{ CAPTURE, PROCESS, OUTPUT, N_STAGES } FrameStage;
+};
+
+//! One frame travelling through the stages.
+struct FrameSlot {
+	cv::Mat frame;	// the frame itself, processed in place
+	cv::Mat yuv;	// the frame as decoded, when the capture gives NV12
+	cv::Mat input;	// copy of the frame before processing, for debugging
+	cv::Mat green;	// green mask of the frame, for debugging
+	int64 index;	// frame number
+};
+
+/** @class FrameRing
+  *
+  * @brief Ring of `depth` slots where every slot goes through capture,
+  *	  processing and output, in this order, and then back to capture.
+  *
+  * Each stage takes the slots in order with acquire(), works on it
+  * without any lock and gives it to the next stage with commit(). A
+  * stage blocks while the previous one has nothing new for it, and the
+  * capture blocks while all slots are still waiting for the output:
+  * that is the backpressure.
+  */
+class FrameRing {
+public:
+	FrameRing ( size_t depth, cv::Size size, int type );
+
+	FrameSlot*	acquire ( Stage::FrameStage stage );
+	void		commit ( Stage::FrameStage stage );
+
+	void	close ();
+	void	abort ();
+
+	size_t depth () const {
+		return slots.size();
+	}
+
+private:
+	std::vector<FrameSlot> slots;
+
+	// how many slots each stage has committed so far
+	int64 done[Stage::N_STAGES];
+
+	bool closed;	// the capture will not commit anything else
+	bool aborted;	// nobody will get anything else
+
+	std::mutex lock;
+	std::condition_variable changed;
+};
+
+#endif //_FRAME_RING_HPP_
@@ -0,0 +1,163 @@
+/** @file green_classifier.hpp
+  * @brief lookup-table classifier that maps a BGR pixel straight to the "best" green mask.
+  */
+
+#ifndef _GREEN_CLASSIFIER_HPP_
+#define _GREEN_CLASSIFIER_HPP_
+
+// std includes
+#include <string>
+#include <vector>
+#include <mutex>
+
+// opencv
+#include <opencv2/core/core.hpp>
+
+#include <bit_mask.hpp>
+
+//! Number of entries of the table, one for every 24 bits BGR color.
+#define GREEN_TABLE_SIZE (1 << 24)
+
+//! The thresholds of the "default" preset
+#define BGREEN_MIN_SAT 		60 //60
+#define BGREEN_HUE 		60 //60
+#define BGREEN_MAX_DISTANCE 	25 //15
+#define BGREEN_MIN_BRIGHT 	25 //25
+#define BGREEN_THRESHOLD 	200 //200
+
+//! Vector kernels are only built by GCC-like compilers for x86.
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+	#define GREEN_SIMD 1
+#else
+	#define GREEN_SIMD 0
+#endif
+
+/** @enum GreenKernel
+  * The ways of classifying a row of pixels, from the slowest to the fastest.
+  */
+typedef enum {
+	GREEN_KERNEL_TABLE,	// one table lookup per pixel, the reference
+	GREEN_KERNEL_SSE41,	// 16 pixels at a time
+	GREEN_KERNEL_AVX2	// 32 pixels at a time
+} GreenKernel;
+
+/** @struct GreenThresholds
+  * What is a "best" green, in the HSV of OpenCV: a saturation above
+  * `min_sat`, a brightness above `min_bright`, a hue at most
+  * `max_distance` from `hue` and 255 less that distance above `threshold`.
+  */
+struct GreenThresholds {
+	int min_sat;
+	int hue;
+	int max_distance;
+	int min_bright;
+	int threshold;
+
+	GreenThresholds () :
+		min_sat ( BGREEN_MIN_SAT ), hue ( BGREEN_HUE ), max_distance ( BGREEN_MAX_DISTANCE ),
+		min_bright ( BGREEN_MIN_BRIGHT ), threshold ( BGREEN_THRESHOLD ){
+	}
+
+	GreenThresholds ( int min_sat, int hue, int max_distance, int min_bright, int threshold ) :
+		min_sat ( min_sat ), hue ( hue ), max_distance ( max_distance ),
+		min_bright ( min_bright ), threshold ( threshold ){
+	}
+
+	bool operator== ( const GreenThresholds& o ) const {
+		return min_sat == o.min_sat && hue == o.hue && max_distance == o.max_distance &&
+			min_bright == o.min_bright && threshold == o.threshold;
+	}
+};
+
+/** @class GreenClassifier
+  *
+  * @brief Bit-packed table with one bit for every BGR color telling
+  *	  if that color is a "best" green.
+  *
+  * The table is built once from the thresholds, passing every color
+  * through the HSV conversion and the green test. After that,
+  * classifying a pixel is just one lookup, no HSV buffer needed.
+  *
+  * When the CPU has SSE4.1 or AVX2, rows are classified by a vector
+  * kernel that does the HSV conversion and the green test in registers,
+  * with compares and blends instead of branches. The kernels are built
+  * for the thresholds of every preset, as constants; other thresholds
+  * get the generic kernels, that keep them in registers. A vector kernel
+  * is only used if it agrees with the table, bit for bit, for every BGR
+  * color.
+  *
+  * Decoded video that comes as NV12 is classified straight from its
+  * planes, with a second table by Y, U and V. It is built on the first
+  * NV12 frame, from the OpenCV conversion to BGR of every YUV color and
+  * the table of BGR: the same mask as converting the frame and then
+  * classifying it.
+  */
+class GreenClassifier {
+public:
+	GreenClassifier ( const GreenThresholds& thresholds = GreenThresholds(),
+			  GreenKernel fastest = GREEN_KERNEL_AVX2, bool specialized = true );
+
+	//! Whether the color (b, g, r) is green.
+	inline bool is_green ( uchar b, uchar g, uchar r ) const {
+		const unsigned int i = (b << 16) | (g << 8) | r;
+		return ( table[i >> 3] >> (i & 7) ) & 1;
+	}
+
+	void classify ( const cv::Mat& frame, cv::Mat& mask ) const;
+	void classify ( const cv::Mat& frame, BitMask& bits ) const;
+	void classify ( const cv::Mat& frame, BitMask& bits, cv::Point at ) const;
+	void classify_nv12 ( const cv::Mat& nv12, BitMask& bits ) const;
+
+	//! The kernel picked for classify().
+	GreenKernel get_kernel () const {
+		return kernel;
+	}
+
+	//! Whether the vector kernels were built for these thresholds, as a preset.
+	bool is_specialized () const {
+		return preset != NULL;
+	}
+
+	const GreenThresholds& get_thresholds () const {
+		return thresholds;
+	}
+
+	//! The classifier built from the configured thresholds, created on the first call.
+	static const GreenClassifier& get ();
+
+	//! The thresholds of get(), only before its first call.
+	static void configure ( const GreenThresholds& thresholds );
+
+	//! A vector kernel for one row: how many pixels it classified.
+	typedef int (*RowKernel) ( const uchar* src, uchar* dst, int n, const GreenThresholds& t );
+
+	//! The kernels of a preset, built for its thresholds.
+	struct Preset {
+		const char* name;
+		GreenThresholds thresholds;
+		RowKernel sse41;
+		RowKernel avx2;
+	};
+
+private:
+	std::vector<uchar> table; // GREEN_TABLE_SIZE bits
+	mutable std::vector<uchar> yuv_table; // GREEN_TABLE_SIZE bits, by V, U and Y
+	mutable std::vector<uint32_t> yuv_range; // for every U and V, the first and last green Y
+	mutable std::once_flag yuv_built;
+	GreenThresholds thresholds;
+	const Preset* preset;	// NULL for the generic kernels
+	GreenKernel kernel;
+
+	void	classify_row ( GreenKernel k, const uchar* src, uchar* dst, int n ) const;
+	bool	agrees_with_table ( GreenKernel k ) const;
+	void	build_yuv_table () const;
+};
+
+/*---------------------------------
+  PROTÓTIPOS
+  ---------------------------------*/
+uchar	green_intensity ( uchar h, uchar s, uchar v, const GreenThresholds& t = GreenThresholds() );
+bool	green_preset ( const std::string& name, GreenThresholds& t );
+bool	load_green_thresholds ( const std::string& path, GreenThresholds& t );
+
+#endif //_GREEN_CLASSIFIER_HPP_
@@ -0,0 +1,73 @@
+/** @file incremental_mask.hpp
+  * @brief green mask of a fixed camera, recomputed only in the tiles of the frame that changed.
+  */
+
+#ifndef _INCREMENTAL_MASK_HPP_
+#define _INCREMENTAL_MASK_HPP_
+
+// std includes
+#include <vector>
+
+// opencv
+#include <opencv2/core/core.hpp>
+
+#include <bit_mask.hpp>
+
+//! Side of the tiles compared with the last frame, in pixels.
+#define INCREMENTAL_MASK_TILE 32
+//! Above this fraction of changed tiles the whole mask is recomputed at once.
+#define INCREMENTAL_MASK_FULL_RATIO 0.5
+
+/** @class IncrementalMask
+  *
+  * @brief The mask of best_green(), kept from a frame to the next and
+  *	  only recomputed where the frame changed.
+  *
+  * Every frame is compared with the last one, tile by tile, and only the
+  * tiles with some different byte are classified again. A pixel of the
+  * median blur depends on the classes within half its window, and a pixel
+  * of the dilation on the blur within half its size, so those halos around the changed tiles are blurred
+  * and dilated again too, from the masks of the whole frame. Everything
+  * else is the mask of the last frame: the result is the one of
+  * best_green(), bit for bit. The steps are kept one bit per pixel, and
+  * only what changed in the result is unpacked.
+  */
+class IncrementalMask {
+public:
+	IncrementalMask ( int tile = INCREMENTAL_MASK_TILE );
+
+	const cv::Mat& update ( const cv::Mat& frame );
+
+	//! The mask of the last frame given to update().
+	const cv::Mat& mask () const {
+		return result;
+	}
+
+	//! Fraction of the tiles that changed in the last update(), 1 when it recomputed everything.
+	double changed () const {
+		return n_tiles ? (double) n_changed / n_tiles : 1.0;
+	}
+
+	//! Forgets the last frame: the next update() recomputes everything.
+	void reset () {
+		previous.release();
+	}
+
+private:
+	int tile;
+
+	cv::Mat previous;	// copy of the last frame
+	BitMask classified;	// the classes of the last frame
+	BitMask blurred;	// their median blur
+	BitMask dilated;	// and its dilation
+	cv::Mat result;		// the same, in bytes
+
+	std::vector<cv::Rect> runs;	// changed tiles, side by side in a row of tiles
+
+	size_t n_changed, n_tiles;
+
+	void	full ( const cv::Mat& frame );
+	void	find_changes ( const cv::Mat& frame );
+};
+
+#endif //_INCREMENTAL_MASK_HPP_
@@ -0,0 +1,69 @@
+/** @file labeler.hpp
+  * @brief single pass connected component labeling of the green mask.
+  */
+
+#ifndef _LABELER_HPP_
+#define _LABELER_HPP_
+
+// std includes
+#include <vector>
+
+// opencv
+#include <opencv2/core/core.hpp>
+
+//! Statistics of one blob: 4-connected pixels with value 255.
+struct Blob {
+	cv::Rect rect;	// bounding rectangle
+	int pixels;	// number of pixels
+};
+
+/** @class ComponentLabeler
+  *
+  * @brief Run-length, union-find labeling in one sweep over the mask.
+  *
+  * Every row is split in runs of 255. A run that touches runs of the
+  * row above joins their components; the components are kept in a
+  * union-find where the root is always the oldest label, so the blobs
+  * come out in the order their first pixel appears in the image, the
+  * same order of a raster scan with floodFill.
+  *
+  * The mask can be given all at once or in horizontal bands, top to
+  * bottom, so a frame can be labeled while the next band is still being
+  * produced. Like the floodFill scan, every 255 is painted with 127.
+  */
+class ComponentLabeler {
+public:
+	void	begin ();
+	void	add_rows ( cv::Mat& band );
+	void	finish ( std::vector<Blob>& blobs );
+
+	//! Labels the whole mask.
+	void label ( cv::Mat& img, std::vector<Blob>& blobs ){
+		begin ();
+		add_rows ( img );
+		finish ( blobs );
+	}
+
+private:
+	//! Pixels [x0, x1) of one row, all of the component `label`.
+	struct Run {
+		int x0, x1;
+		int label;
+	};
+
+	//! Bounding box and area, kept in the root of every component.
+	struct Stats {
+		int x0, y0, x1, y1;
+		int pixels;
+	};
+
+	std::vector<Run> prev, cur;	// runs of the last row and of the current one
+	std::vector<int> parent;	// union-find, indexed by label
+	std::vector<Stats> stats;	// indexed by label, valid for the roots
+	int row;			// next row to be added
+
+	int	find ( int label );
+	int	unite ( int a, int b );
+};
+
+#endif //_LABELER_HPP_
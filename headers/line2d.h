@@ -60,11 +60,57 @@ public:
 
 	float shortestDistanceTo (cv::Point2f pt);
 
+	// The same for n points given as separate x and y arrays, 4 at a time.
+	void shortestDistancesTo (const float* x, const float* y, int n, float* dist) const;
+	int farthestOf (const float* x, const float* y, int n, float* dist) const;
+
 public:
 	cv::Point2f pt1; // A line segment is defined by 2 points.
 	cv::Point2f pt2; // A line segment is defined by 2 points.
 	float length; // Precomputed length.
 };
 
+/*============================================================================*/
+/* Line segment between integer points, without angles: the distances are    */
+/* compared squared and scaled by the squared length, so they stay exact      */
+/* integers, with no division or square root for every point.                 */
+/*============================================================================*/
+
+class LineSegment2i
+{
+public:
+	LineSegment2i (cv::Point pt1, cv::Point pt2);
+
+	// Shortest distance to pt, squared and times squaredLength, or only squared if the segment is a single point. Only for comparing points against the same segment.
+	inline int64 scaledDistanceTo (cv::Point pt) const
+	{
+		const int64 ax = pt.x - pt1.x, ay = pt.y - pt1.y; // Vector pt1 to pt.
+		const int64 dot = ax*dx + ay*dy;
+
+		if (squaredLength == 0) // A single point: nothing to scale by.
+			return (ax*ax + ay*ay);
+
+		if (dot <= 0) // The point is beyond pt1.
+			return ((ax*ax + ay*ay) * squaredLength);
+
+		if (dot >= squaredLength) // The point is beyond pt2.
+		{
+			const int64 bx = pt.x - pt2.x, by = pt.y - pt2.y;
+			return ((bx*bx + by*by) * squaredLength);
+		}
+
+		const int64 cross = ax*dy - ay*dx; // Twice the area of the triangle, its height times the length.
+		return (cross*cross);
+	}
+
+	float distanceFromScaled (int64 scaled) const;
+
+public:
+	cv::Point pt1; // A line segment is defined by 2 points.
+	cv::Point pt2; // A line segment is defined by 2 points.
+	int64 dx, dy; // pt2 - pt1.
+	int64 squaredLength; // Precomputed squared length.
+};
+
 /*============================================================================*/
 #endif // __LINE2D_H
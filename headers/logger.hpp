@@ -0,0 +1,94 @@
+/** @file logger.hpp
+  * @brief non blocking log: fixed size records go through a lock free ring to a thread that writes them.
+  */
+
+#ifndef _LOGGER_HPP_
+#define _LOGGER_HPP_
+
+// std includes
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <ostream>
+#include <stdint.h>
+
+//--MACROS----------------------------------------------------
+#define LOG_RING_SIZE		4096	// records in the ring, a power of two
+#define LOG_TEXT_SIZE		112	// bytes of a message, the rest is cut
+#define LOG_DRAIN_PERIOD_MS	5	// how long the writer sleeps when the ring is empty
+
+/** @struct LogRecord
+  * One message, always the same size: nothing is allocated from the
+  * thread that logs to the one that writes.
+  */
+struct LogRecord {
+	int64_t		time;		// ns of steady_clock
+	const char*	function;	// __PRETTY_FUNCTION__, a literal
+	uint32_t	thread;		// small number of the thread that logged
+	uint16_t	level;
+	uint16_t	length;		// of `text`
+	char		text[LOG_TEXT_SIZE];
+};
+
+/** @class Logger
+  *
+  * @brief Bounded ring of records, many producers and one consumer: the
+  *	  writer thread, that prints them to the standard output.
+  *
+  * push() never blocks and never allocates. Every cell has a sequence
+  * number that says whether it is free for the producer of that turn or
+  * full for the writer, so the producers only compete for the head with
+  * a compare and swap. When the ring is full the record is dropped and
+  * counted; the writer tells how many were lost.
+  */
+class Logger {
+public:
+	static Logger& get ();
+	~Logger ();
+
+	void push ( const LogRecord& record );
+
+	//! When the log started, the origin of the times printed.
+	std::chrono::steady_clock::time_point origin () const {
+		return start;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		LogRecord record;
+	};
+
+	Cell cells[LOG_RING_SIZE];
+	alignas(64) std::atomic<size_t> head;	// next cell to fill
+	alignas(64) size_t tail;		// next cell to write, only for the writer
+	std::atomic<uint64_t> dropped;
+	std::atomic<bool> stopping;
+
+	std::chrono::steady_clock::time_point start;
+	std::thread writer;
+
+	Logger ();
+
+	bool pop ( LogRecord& record );
+	void drain ();
+};
+
+/** @class LogLine
+  *
+  * @brief One message: formatted with << in a record on the stack, by a
+  *	  stream of the thread that does not allocate, and pushed to the
+  *	  Logger when the LogLine ends.
+  */
+class LogLine {
+public:
+	LogLine ( const char* function, unsigned int level );
+	~LogLine ();
+
+	std::ostream& stream ();
+
+private:
+	LogRecord record;
+};
+
+#endif //_LOGGER_HPP_
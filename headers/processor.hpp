@@ -0,0 +1,99 @@
+/** @file processor.hpp
+  * @brief the whole effect on one stream of frames, with all its buffers kept from a frame to the next.
+  */
+
+#ifndef _PROCESSOR_HPP_
+#define _PROCESSOR_HPP_
+
+// std includes
+#include <vector>
+
+// opencv
+#include <opencv2/core/core.hpp>
+
+#include <HYP.hpp>
+#include <thread_pool.hpp>
+#include <quad_tracker.hpp>
+#include <incremental_mask.hpp>
+
+/** @struct ProcessorSettings
+  * How a Processor searches the cards.
+  */
+struct ProcessorSettings {
+	int track_interval;	// frames between full detections, tracking in between
+	int pyramid_scale;	// the full detection runs in a frame this many times smaller
+	int refine_radius;	// how far from the scaled corners they are refined
+	bool draw_corners;	// circles on the corners found
+	bool incremental;	// the mask of the full detection only recomputed where the frame changed
+
+	ProcessorSettings () :
+		track_interval ( 1 ), pyramid_scale ( 1 ), refine_radius ( 2 ), draw_corners ( false ), incremental ( false ){
+	}
+};
+
+/** @class Processor
+  *
+  * @brief Puts the past in the green quadrilaterals of every frame of one
+  *	  stream. Embeddable: the caller brings the frames and the past.
+  *
+  * Every buffer, of the frame or of the ROIs, is kept by the Processor
+  * and only grows: once the frame geometry and the number of ROIs stop
+  * changing, process() allocates no image or vector of its own. The
+  * buffers of a ROI are per index of the pool, so many Processors can
+  * share one pool, each called from its own thread.
+  */
+class Processor {
+public:
+	Processor ( ThreadPool& pool, const ProcessorSettings& settings = ProcessorSettings() );
+
+	void process ( cv::Mat& frame, const cv::Mat& past, const cv::Mat& nv12 = cv::Mat() );
+
+	//! Green mask of the last frame, 127 on the blobs, only where it was searched.
+	const cv::Mat& green () const {
+		return green_blob;
+	}
+
+	//! The quadrilaterals of the last frame, in frame coordinates.
+	const std::vector<Quadrilateral>& quadrilaterals () const {
+		return found;
+	}
+
+private:
+	//! What a worker keeps between frames to process one ROI.
+	struct RoiScratch {
+		GreenScratch green;	// steps of the green of a ROI
+		cv::Mat contours;	// copy of the blob, findContours changes it
+		QuadScratch quad;	// curves and scores
+		std::vector<Blob> blobs;	// components of a search window
+	};
+
+	ThreadPool& pool;
+	ProcessorSettings settings;
+	QuadTracker tracker;
+
+	cv::Mat green_blob;	// of the whole frame
+	GreenScratch green_scratch;	// steps of the green of the whole frame
+	cv::Mat small;		// the frame of the coarse detection
+	cv::Mat small_green;
+	IncrementalMask incremental;	// of the frame of the full detection, small or not
+	cv::Mat yuv;		// the frame as decoded, NV12, if it came so
+
+	std::vector<cv::Rect> roi;
+	std::vector<cv::Rect> coarse;	// the ROIs in the small frame
+	std::vector< std::vector<Quadrilateral> > quadrilateral;	// per ROI, in the ROI order
+	std::vector<Quadrilateral> found;
+	std::vector<RoiScratch> scratch;	// per index of the pool
+
+	bool track ( cv::Mat& frame );
+	void detect_coarse ( cv::Mat& frame );
+	void detect ( cv::Mat& frame );
+	void gather ();
+	void find_green ( const cv::Mat& frame, cv::Mat& mask );
+
+	void green_roi ( const cv::Mat& frame_roi, cv::Mat& blob_roi, RoiScratch& scratch );
+	void find_roi_quadrilaterals ( const cv::Mat& blob_roi, RoiScratch& scratch, std::vector<Quadrilateral>& quadrilateral, int scale = 1 );
+	template <typename Body>
+	void for_each_roi ( const Body& body );
+};
+
+#endif //_PROCESSOR_HPP_
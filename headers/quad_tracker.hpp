@@ -0,0 +1,44 @@
+/** @file quad_tracker.hpp
+  * @brief carries the quadrilaterals from one frame to the next, so the full detection is not needed every frame.
+  */
+
+#ifndef _QUAD_TRACKER_HPP_
+#define _QUAD_TRACKER_HPP_
+
+// std includes
+#include <vector>
+
+// HYP
+#include <HYP.hpp>
+
+//--MACROS----------------------------------------------------
+#define TRACK_SEARCH_MARGIN	24	// pixels around a quadrilateral where it is searched in the next frame
+#define TRACK_MAX_AREA_RATIO	1.5f	// how much the area may change from one frame to the next
+
+/** @class QuadTracker
+  *
+  * @brief Quadrilaterals of the last frame, in frame coordinates.
+  *
+  * In the next frame every one is searched only in a window around it.
+  * It is found again if a new quadrilateral has its center no farther
+  * than TRACK_SEARCH_MARGIN and an area of the same size, give or take
+  * TRACK_MAX_AREA_RATIO. The full detection is due every `interval`
+  * frames, when a quadrilateral was not found again, and while there is
+  * nothing to track, because a new card is only seen by it.
+  */
+class QuadTracker {
+public:
+	QuadTracker ( int interval );
+
+	bool	due () const;
+	void	windows ( cv::Size size, std::vector<cv::Rect>& out ) const;
+	bool	found_again ( std::vector<Quadrilateral>& found ) const;
+	void	update ( const std::vector<Quadrilateral>& found, bool detected );
+
+private:
+	std::vector<Quadrilateral> tracked;
+	int interval;		// frames from one full detection to the next
+	int since_detection;	// frames since the last full detection
+};
+
+#endif //_QUAD_TRACKER_HPP_
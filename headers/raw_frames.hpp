@@ -0,0 +1,148 @@
+/** @file raw_frames.hpp
+  * @brief container of raw frames, written as they come and replayed from a memory mapping.
+  */
+
+#ifndef _RAW_FRAMES_HPP_
+#define _RAW_FRAMES_HPP_
+
+// std includes
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+
+// opencv
+#include <opencv2/core/core.hpp>
+
+//! The extension of the container, for inputs and outputs.
+#define RAW_FRAMES_EXTENSION	".hypraw"
+//! First bytes of the file, with the version of the format.
+#define RAW_FRAMES_MAGIC	"HYPRAW01"
+//! The header and every record take a whole number of these.
+#define RAW_FRAMES_PAGE		4096
+//! Bytes before the pixels in a record: timestamp and index.
+#define RAW_FRAMES_INFO		64
+
+/*	The file is a header of RAW_FRAMES_PAGE bytes, then one record per
+ *	frame, all of the same size: the timestamp and the index of the
+ *	frame, the rows one after the other with no padding from
+ *	RAW_FRAMES_INFO bytes on, and zeros up to the next page. The
+ *	numbers are in the byte order of the machine that wrote it.
+ */
+
+//! The header, at the start of the file.
+struct RawFramesHeader {
+	char magic[8];		// RAW_FRAMES_MAGIC
+	int32_t width, height;
+	int32_t type;		// OpenCV type of the pixels, CV_8UC3 and so on
+	int32_t reserved;
+	uint64_t row_bytes;	// bytes of a row
+	uint64_t record_bytes;	// bytes from a record to the next
+	uint64_t count;		// frames, when the writer was closed; 0 if it was not
+	double fps;
+};
+
+//! Before the pixels of every record.
+struct RawFrameInfo {
+	int64_t timestamp;	// microseconds since the first frame was written
+	int64_t index;		// of the frame in the run that wrote it
+};
+
+/** @class RawWriter
+  *
+  * @brief Appends frames of one size and type to a container, with
+  *	  the time at which they were written.
+  */
+class RawWriter {
+public:
+	RawWriter () : file ( NULL ), failed ( false ), count ( 0 ), start ( 0 ){
+	}
+
+	~RawWriter (){
+		close();
+	}
+
+	bool	open ( const std::string& path, cv::Size size, int type, double fps );
+	bool	write ( const cv::Mat& frame );
+	bool	close ();
+
+	bool is_open () const {
+		return file != NULL;
+	}
+
+private:
+	FILE* file;
+	std::string path;
+	bool failed;	// a write failed, nothing else is written
+	RawFramesHeader header;
+	uint64_t count;
+	int64 start;	// ticks of the first frame
+	std::vector<char> padding;	// zeros, for the end of a record
+
+	RawWriter ( const RawWriter& );
+	RawWriter& operator= ( const RawWriter& );
+};
+
+/** @class RawReader
+  *
+  * @brief Maps a container in memory and gives its frames as Mats over
+  *	  the mapping, with no copy and no decoding.
+  *
+  * The mapping is private: the frames can be changed in place, as the
+  * Processor does, and only the pages written get a copy of their own;
+  * the file never changes. release() drops those copies, and the pages
+  * read, of the frames nobody uses anymore. The page cache keeps the
+  * file between runs, so a replay reads at memory bandwidth.
+  */
+class RawReader {
+public:
+	RawReader () : base ( NULL ), length ( 0 ), n ( 0 ), released ( 0 ){
+	}
+
+	~RawReader (){
+		close();
+	}
+
+	bool	open ( const std::string& path );
+	void	close ();
+
+	cv::Mat	frame ( size_t i ) const;
+	void	release ( size_t before );
+
+	//! Microseconds between the first frame written and the frame `i`.
+	int64_t timestamp ( size_t i ) const {
+		return info( i ).timestamp;
+	}
+
+	size_t size () const {
+		return n;
+	}
+
+	double fps () const {
+		return header().fps;
+	}
+
+private:
+	uchar* base;
+	size_t length;
+	size_t n;	// whole records in the file
+	size_t released;	// records before this one were released
+
+	const RawFramesHeader& header () const {
+		return *(const RawFramesHeader*) base;
+	}
+
+	const RawFrameInfo& info ( size_t i ) const {
+		return *(const RawFrameInfo*) ( base + RAW_FRAMES_PAGE + i * header().record_bytes );
+	}
+
+	RawReader ( const RawReader& );
+	RawReader& operator= ( const RawReader& );
+};
+
+/*---------------------------------
+  PROTÓTIPOS
+  ---------------------------------*/
+bool	is_raw_frames ( const std::string& path );
+
+#endif //_RAW_FRAMES_HPP_
@@ -0,0 +1,108 @@
+/** @file stage_timer.hpp
+  * @brief latency histograms of every stage of the pipeline.
+  */
+
+#ifndef _STAGE_TIMER_HPP_
+#define _STAGE_TIMER_HPP_
+
+// std includes
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+
+//--MACROS----------------------------------------------------
+#define LATENCY_SUB_BITS	5	// 32 buckets for every power of two: values within 1/32
+#define LATENCY_MAX_BITS	40	// up to 2^40 ns, about 18 minutes
+#define LATENCY_BUCKETS		( (LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS )
+
+/** @class LatencyHistogram
+  *
+  * @brief Log-linear histogram of durations in nanoseconds, like HDR
+  *	  histograms: every power of two is split in 2^LATENCY_SUB_BITS
+  *	  buckets, so a percentile is off by at most 1/32 of its value.
+  *
+  * The counters are atomic and relaxed: any thread can add while
+  * another one reads, and a read sees every add that finished before it
+  * but maybe not the ones still going on.
+  */
+class LatencyHistogram {
+public:
+	LatencyHistogram ();
+
+	void		add ( uint64_t ns );
+	uint64_t	percentile ( double p ) const;
+
+	uint64_t count () const {
+		return total.load( std::memory_order_relaxed );
+	}
+	uint64_t max () const {
+		return maximum.load( std::memory_order_relaxed );
+	}
+	double mean () const {
+		uint64_t n = count();
+		return n ? (double) sum.load( std::memory_order_relaxed ) / n : 0;
+	}
+
+private:
+	std::atomic<uint64_t> buckets[LATENCY_BUCKETS];
+	std::atomic<uint64_t> total, sum, maximum;
+
+	static int	index ( uint64_t ns );
+	static uint64_t	highest ( int index );
+};
+
+/** @namespace Timing
+  * One histogram for every stage, for the whole program.
+  */
+namespace Timing{
+	typedef enum{
+		CAPTURE,	// reading a frame
+		CONVERT,	// NV12 to BGR, when the capture gives NV12
+		DOWNSCALE,	// the smaller frame of the coarse detection
+		FRAME_DIFF,	// the tiles that changed, for the incremental mask
+		CLASSIFY,	// green mask
+		BLUR_DILATE,	// median blur and dilation of the mask
+		LABEL,		// connected components
+		GROUP,		// extending and grouping the ROIs
+		CONTOURS,	// findContours
+		QUAD_FIT,	// RDP and sorting of the corners
+		WARP_COMPOSITE,	// the past put in a quadrilateral
+		PROCESS,	// the whole processing of a frame
+		OUTPUT,		// writing the frame to the output file, or queueing it with -a
+		WRITE,		// the background writer: snapshots and the output of -a
+		DISPLAY,	// windows and keys
+		N_STAGES
+	} Stage;
+
+	extern bool enabled;
+
+	const char*	name ( Stage stage );
+	void		record ( Stage stage, uint64_t ns );
+	bool		dump ( const std::string& path );
+};
+
+/** @class ScopedTimer
+  *
+  * @brief Adds to the histogram of a stage the time from its creation to
+  *	  its end. Costs nothing but a branch while Timing::enabled is false.
+  */
+class ScopedTimer {
+public:
+	ScopedTimer ( Timing::Stage stage ) : stage ( stage ){
+		if( Timing::enabled )
+			start = std::chrono::steady_clock::now();
+	}
+
+	~ScopedTimer (){
+		if( Timing::enabled )
+			Timing::record( stage, std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start ).count() );
+	}
+
+private:
+	Timing::Stage stage;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif //_STAGE_TIMER_HPP_
@@ -0,0 +1,88 @@
+/** @file thread_pool.hpp
+  * @brief fixed set of worker threads for the data parallel parts of the pipeline.
+  */
+
+#ifndef _THREAD_POOL_HPP_
+#define _THREAD_POOL_HPP_
+
+// std includes
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/** @class ThreadPool
+  *
+  * @brief Workers waiting for tasks. The thread that calls parallel_for()
+  *	  works too, so a pool of N workers runs N+1 iterations at a time.
+  *
+  * Every iteration receives the index of who runs it, from 0 to size()-1,
+  * the caller being the last one. That index is meant to pick scratch
+  * buffers that belong to one worker, with no locks, but only while a
+  * single thread calls parallel_for(): several callers at once, like the
+  * streams sharing one pool, all get the last index.
+  *
+  * Every worker has its own queue of tasks and takes from its front;
+  * when it is empty the worker steals from the back of the others. The
+  * tasks of a loop are spread over the queues, so many threads calling
+  * parallel_for() at once do not fight for one lock, and an idle worker
+  * always helps the busiest loop.
+  *
+  * Nothing is allocated once the pool warmed up: the bookkeeping of a
+  * loop is reused when no worker holds it anymore, and the queues only
+  * grow.
+  */
+class ThreadPool {
+public:
+	ThreadPool ( size_t n_workers );
+	~ThreadPool ();
+
+	//! How many threads may run iterations: the workers plus the caller.
+	size_t size () const {
+		return workers.size() + 1;
+	}
+
+	void parallel_for ( size_t n, const std::function<void (size_t i, size_t worker)>& body );
+
+private:
+	//! One call of parallel_for(); a task is a Loop to help with.
+	struct Loop;
+
+	//! Tasks of one worker, in a ring that only grows.
+	struct Queue {
+		std::vector<Loop*> ring;
+		size_t first;
+		size_t count;
+		std::mutex lock;
+
+		Queue () : first ( 0 ), count ( 0 ){
+		}
+
+		void	push_back ( Loop* loop );
+		Loop*	pop_front ();
+		Loop*	pop_back ();
+	};
+
+	std::vector<std::thread> workers;
+	std::unique_ptr<Queue[]> queues;	// one per worker
+	size_t n_queues;
+	std::atomic<size_t> pending;		// tasks in all the queues
+	std::atomic<size_t> next_queue;		// where the next loop starts to push
+
+	std::vector< std::unique_ptr<Loop> > loops;	// every Loop ever needed, reused
+	std::mutex loops_lock;
+
+	bool stopping;
+	std::mutex sleep_lock;
+	std::condition_variable wakeup;
+
+	Loop*	free_loop ( size_t users );
+	Loop*	take ( size_t worker );
+	void	help ( Loop* loop, size_t worker );
+	void	work ( size_t worker );
+};
+
+#endif //_THREAD_POOL_HPP_
@@ -3,20 +3,20 @@
   */
 //--INCLUDES--------------------------------------------------
 #include <HYP.hpp>
+#include <green_classifier.hpp>
+#include <stage_timer.hpp>
 #include <iostream>
+#include <cmath>
+#include <cfloat>
+#include <climits>
 
 //--MACROS----------------------------------------------------
-#define BGREEN_MIN_SAT 		60 //60
-#define BGREEN_HUE 		60 //60	
-#define BGREEN_MAX_DISTANCE 	25 //15
-#define BGREEN_MIN_BRIGHT 	25 //25
-#define BGREEN_THRESHOLD 	200 //200
-#define BGREEN_MEDIAN_BLUR_WIN 	9  //9
-///////////////////////////////////
 #define QUADRILATERAL_AREA_THRESHOLD 500
+#define REPLACE_QUAD_MARGIN ( BGREEN_DILATE_SIZE + 4 )	// the blob of a quadrilateral past its edges: the dilation and sides a little bent
 ///////////////////////////////////
 #define ROI_MIN_PIXEL 	100
 #define ROI_RECT_MARGIN 5
+#define RECT_GRID_MIN_CELL 16
 //////////////////////////
 
 
@@ -46,162 +46,200 @@ using namespace cv;
   */
 Mat best_green ( const Mat& frame ){
 	// Frame that will be green-processed
-	Mat processed_frame ( frame.size(), CV_8UC1 );
-	Mat frame_hsv; // frame converted to the HSV color space
-
-	// Convert to the HSV color space!
-	cvtColor( frame, frame_hsv, CV_BGR2HSV );
+	Mat processed_frame;
+	GreenScratch scratch;
 
-	// Pointers!
-	const uchar* ptr_src;
-	uchar* ptr_dst;
+	best_green ( frame, processed_frame, scratch );
+	return processed_frame;
+}
 
-	for ( int i = 0; i<frame_hsv.rows; i++ ){
-		
-		// Pointers to the lines!!
-		ptr_src = frame_hsv.ptr<uchar>(i);
-		ptr_dst = processed_frame.ptr<uchar>(i);
-
-		// For every line...
-		for ( int j = 0; j<frame_hsv.cols; j++ ){
-
-			int green_intensity; // Holds the green intensity!
-
-			/*	Test the green color.
-			 *
-			 *	If the green intensity were less than BGREEN_MIN_SAT or
-			 *	distance from the green on Hue channel were greater
-			 *	than BGREEN_MAX_DISTANCE or the brightness were not at least
-			 *	BGREEN_MIN_BRIGHT: forget about this green. Set zero for this one.
-			 *
-			 *	If the green pass to the above test, so the color for
-			 *	this is 255 less the distance of BGREEN_HUE. Pass the
-			 *	result value for the BGREEN_THRESHOLD.
-			 */
-			if( ptr_src[Color::S] <= BGREEN_MIN_SAT )
-				green_intensity = 0;
-			else if ( ptr_src[Color::V] <= BGREEN_MIN_BRIGHT) //25
-				green_intensity = 0;
-			else if ( ptr_src[Color::H] < BGREEN_HUE - BGREEN_MAX_DISTANCE || //15
-				  ptr_src[Color::H] > BGREEN_HUE + BGREEN_MAX_DISTANCE )  //15
-				green_intensity = 0;
-			else{
-				green_intensity = 255 - (ptr_src[Color::H] - BGREEN_HUE);
-				green_intensity = (green_intensity > BGREEN_THRESHOLD)?255:0;
-			}
+/** @fn void best_green ( const Mat& frame, Mat& mask, GreenScratch& scratch )
+  *
+  * @brief	The same mask, in `mask`, with `scratch` for the steps. They
+  *		are only allocated if they do not have the size of `frame`
+  *		yet, so the same ones can be reused frame after frame.
+  *
+  * The mask is only one bit per pixel until the end: the median of a
+  * mask of 0 and 255 is the majority of its window, and the dilation an
+  * or of shifted words. Only the result is unpacked to bytes.
+  */
+void best_green ( const Mat& frame, Mat& mask, GreenScratch& scratch ){
+	// Straight from BGR to the green mask, one lookup per pixel
+	{
+		ScopedTimer timer ( Timing::CLASSIFY );
+		GreenClassifier::get().classify( frame, scratch.green );
+	}
 
-			*ptr_dst = green_intensity;
+	smooth_green ( mask, scratch );
+}
 
-			// Go pointers!!
-			ptr_src += frame_hsv.channels();
-			ptr_dst += processed_frame.channels();
-		}
+/** @fn void best_green_nv12 ( const Mat& nv12, Mat& mask, GreenScratch& scratch )
+  *
+  * @brief	The same mask, from the planes of a frame decoded as NV12:
+  *		the same as converting it to BGR first, without doing it.
+  */
+void best_green_nv12 ( const Mat& nv12, Mat& mask, GreenScratch& scratch ){
+	{
+		ScopedTimer timer ( Timing::CLASSIFY );
+		GreenClassifier::get().classify_nv12( nv12, scratch.green );
 	}
 
+	smooth_green ( mask, scratch );
+}
+
+/** @fn void smooth_green ( Mat& mask, GreenScratch& scratch )
+  *
+  * @brief	The median blur and the dilation of the classes in
+  *		`scratch.green`, unpacked in `mask`.
+  */
+void smooth_green ( Mat& mask, GreenScratch& scratch ){
+	ScopedTimer timer ( Timing::BLUR_DILATE );
+
 	// Median blur ---------------------------------------------
-	Mat buffer_helper;
-	medianBlur(processed_frame, buffer_helper, BGREEN_MEDIAN_BLUR_WIN);
+	bit_median( scratch.green, scratch.blur, BGREEN_MEDIAN_BLUR_WIN );
 
 	// Dilatation! ---------------------------------------------
-	Mat element = getStructuringElement ( MORPH_RECT, Size(2, 2), Point(1, 1) );
-	dilate( buffer_helper, processed_frame, element );
+	bit_dilate( scratch.blur, scratch.green, BGREEN_DILATE_SIZE );
 
-	return processed_frame;
+	scratch.green.unpack( mask );
 }
 
-//--FIND_GOOD_QUADRILATERALS--------------------------------------------------------
-
-//! Simple struct to link one score to point.
-/**
-  * Will be useful only for sort purpose.
+/** @fn Mat grow ( Mat& storage, Size size, int type )
+  *
+  * @return	A Mat of `size` and `type` over the bytes of `storage`, that
+  *		is only reallocated when it is too small. The Mat is valid
+  *		while `storage` is not reallocated.
   */
-typedef struct cord_score {
-	float score;
-	Point p;
-} cord_score;
-
-// Function that compares two structs for the sort algorithm
-bool cord_score_comp ( cord_score c0, cord_score c1 ){
-	return c0.score < c1.score;
+Mat grow ( Mat& storage, Size size, int type ){
+	size_t bytes = (size_t) size.area() * CV_ELEM_SIZE( type );
+	if( storage.total() * storage.elemSize() < bytes )
+		storage.create( 1, (int) bytes, CV_8UC1 );
+	return Mat( size, type, storage.data );
 }
 
-/** @fn 	void RDP_score ( vector <Point>& curve, vector <float>& points, int a=0, int b=0 )
+//--FIND_GOOD_QUADRILATERALS--------------------------------------------------------
+
+/** @fn 	void RDP_score ( const vector <Point>& curve, RDPScratch& scratch )
   *
   * @brief 		Scores based on Ramer–Douglas–Peucker algorithm.
   *
-  * @param curve 	Vector of points order representing a curve of points.
-  * 
-  * @param score	Vector of scores based on Ramer–Douglas–Peucker algorithm.
+  * The curve is closed: it is first split at the point farthest from
+  * curve[0], and both get that distance as score. Then every piece is
+  * split at the point farthest from its chord, that gets the distance
+  * as score, until the pieces have no point out of their chord. The
+  * pieces wait in an explicit stack instead of the call stack.
+  *
+  * The farthest point is found in integers, squared distances and
+  * cross products with LineSegment2i: only its distance has a root.
   *
-  * @param a		Index of the vector of point, just of recursion purpose.
-  * @param b		Index of the vector of point, just of recursion purpose.
+  * @param curve 	Vector of points order representing a closed curve of points.
+  *
+  * @param scratch	Buffers reused between calls. The score of every
+  *			point of `curve` is left in `scratch.score`.
   */
-void RDP_score ( vector <Point>& curve, vector <float>& score, int a=0, int b=0 ){
+void RDP_score ( const vector <Point>& curve, RDPScratch& scratch ){
 	DEBUG("", 3);			
 
-	// If were the first iteration...
-	if(!b) b = curve.size();
+	const int n = curve.size();
+	vector <float>& score = scratch.score;
+	vector <Vec2i>& stack = scratch.stack;
 
-	// creates a line segment
-	LineSegment2d line (curve[a], curve[b]);
+	score.assign( n, 0.f );
+	stack.clear();
 
-	// Finds the greatest distance to the curve.
-	float 	max_dist  = 0;
+	// First split: the farthest point from curve[0]
+	int64 	max_dist  = 0;
 	int 	max_index = 0;
-	for ( int i=a+1; i<b; i++ ){
-		float d = line.shortestDistanceTo( curve[i] );
-		
+	for ( int i=1; i<n; i++ ){
+		const int64 dx = curve[i].x - curve[0].x, dy = curve[i].y - curve[0].y;
+		int64 d = dx*dx + dy*dy;
+
 		if( d > max_dist ){
 			max_dist = d;
 			max_index = i;
 		}
 	}
 
-	// Save the score
-	score[max_index] = max_dist;
+	if( !max_index ) return;
 
-	if( b-a <= 2 ) return;
+	score[0] = score[max_index] = (float) sqrt( (double) max_dist );
+	stack.push_back( Vec2i(0, max_index) );
+	stack.push_back( Vec2i(max_index, n) ); // n is curve[0] again
 
-	// Recursive call
-	RDP_score ( curve, score, a, max_index );
-	RDP_score ( curve, score, max_index, b );
+	while( !stack.empty() ){
+		int a = stack.back()[0];
+		int b = stack.back()[1];
+		stack.pop_back();
+
+		if( b-a < 2 ) continue;
+
+		// creates a line segment
+		LineSegment2i line (curve[a], curve[b % n]);
+
+		// Finds the greatest distance to the curve.
+		max_dist  = 0;
+		max_index = 0;
+		for ( int i=a+1; i<b; i++ ){
+			int64 d = line.scaledDistanceTo( curve[i] );
+
+			if( d > max_dist ){
+				max_dist = d;
+				max_index = i;
+			}
+		}
+
+		// Everything on the chord, nothing else to split
+		if( !max_index ) continue;
+
+		// Save the score
+		score[max_index] = line.distanceFromScaled( max_dist );
+
+		stack.push_back( Vec2i(a, max_index) );
+		stack.push_back( Vec2i(max_index, b) );
+	}
 }
 
-/** @fn void approximate_quadrilateral ( vector<Point>& curve, Quadrilateral& q )
+/** @fn void approximate_quadrilateral ( const vector<Point>& curve, Quadrilateral& q, RDPScratch& scratch )
   * 
   * @param curve 	Vector of Points sorted that represents a curve of points;
   *
-  * @param q		Approximate quadrilateral of that curve;
+  * @param q		Approximate quadrilateral of that curve: its four
+  *			points of greatest score;
   *
+  * @param scratch	Buffers reused between calls.
   */
-void approximate_quadrilateral ( vector<Point>& curve, Quadrilateral& q ){
+void approximate_quadrilateral ( const vector<Point>& curve, Quadrilateral& q, RDPScratch& scratch ){
 	DEBUG("", 3);			
 	// We don't care if the curve is little than 4. Because quadrilateral has 4 points.
 	if( curve.size() < 4 ) return;
 
-	// holds RPD score
-	vector<float> score(curve.size());
 	// calculates RPD_score
-	RDP_score ( curve, score );
-
-	// link all point to a score
-	vector<cord_score> cord_and_score;
-	for ( size_t i=0; i<curve.size(); i++ ){
-		cord_score cs = { score[i], curve[i] };
-		cord_and_score.push_back( cs );
+	RDP_score ( curve, scratch );
+	const vector<float>& score = scratch.score;
+
+	// The four greatest scores, in decreasing order, by insertion
+	int top[QUADRILATERAL_SIZE] = { 0, 1, 2, 3 };
+	sort( top, top + QUADRILATERAL_SIZE, [&] ( int i, int j ){
+		return score[i] > score[j] || ( score[i] == score[j] && i < j );
+	});
+
+	for ( int i=QUADRILATERAL_SIZE; i<(int) curve.size(); i++ ){
+		if( !( score[i] > score[top[QUADRILATERAL_SIZE-1]] ) )
+			continue;
+
+		int k = QUADRILATERAL_SIZE-1;
+		for ( ; k > 0 && score[i] > score[top[k-1]]; k-- )
+			top[k] = top[k-1];
+		top[k] = i;
 	}
 
-	/* TODO: 	quick4th - A function to find the four
-	 *		greater values of the vector	
-	 */
-	// sort by score
-	std::sort ( cord_and_score.rbegin(), cord_and_score.rend(), cord_score_comp );
-
-	// Stores the points
-	q[0] = cord_and_score[0].p;
-	q[1] = cord_and_score[1].p;
-	q[2] = cord_and_score[2].p;
-	q[3] = cord_and_score[3].p;
+	// Stores the points in the order of the curve, so they go around
+	// the quadrilateral and not across it
+	sort( top, top + QUADRILATERAL_SIZE );
+	q[0] = curve[top[0]];
+	q[1] = curve[top[1]];
+	q[2] = curve[top[2]];
+	q[3] = curve[top[3]];
 	
 }
 
@@ -213,52 +251,57 @@ void approximate_quadrilateral ( vector<Point>& curve, Quadrilateral& q ){
   */
 void sort_point_based_on_center ( Quadrilateral& q ){
 
-	// Get center of mass
-	Point2f c (0, 0);
-
-	// The center of the mass is the mean of the points!
-	for( size_t i=0; i<q.size(); i++ ){
-		c.x += q[i].x;
-		c.y += q[i].y;
-	}
-
-	c.x /= q.size();
-	c.y /= q.size();
-
 	// Sort!
-	//  Vectors that will catch top points and bottom points, respectively.
-	std::vector<cv::Point> top, bot;
-
-	for (size_t i = 0; i < q.size(); i++){
-		if (q[i].y < c.y)
-			top.push_back(q[i]);
-		else
-			bot.push_back(q[i]);
+	//  The two points with the smallest y are the top ones. Splitting them
+	//  by the y of the center left three points on top, and one at the
+	//  bottom, when the card was turned by about 45 degrees.
+	cv::Point p[QUADRILATERAL_SIZE] = { q[0], q[1], q[2], q[3] };
+	//  Insertion sort: stable as stable_sort, without its buffer.
+	for ( int i = 1; i < QUADRILATERAL_SIZE; i++ ){
+		cv::Point key = p[i];
+		int j = i;
+		for ( ; j > 0 && key.y < p[j-1].y; j-- )
+			p[j] = p[j-1];
+		p[j] = key;
 	}
 
+	//  Top points and bottom points, respectively.
+	const cv::Point* top = p;
+	const cv::Point* bot = p + 2;
+
 	q[0] = top[0].x > top[1].x ? top[1] : top[0]; // Top left
 	q[1] = top[0].x > top[1].x ? top[0] : top[1]; // Top right
 	q[3] = bot[0].x > bot[1].x ? bot[1] : bot[0]; // Bottom left
 	q[2] = bot[0].x > bot[1].x ? bot[0] : bot[1]; // Bottom right
 }
 
-/** @fn void get_good_quadrilaterals (Mat& img, vector<Quadrilateral>& quadrilateral);
+/** @fn void get_good_quadrilaterals (Mat& img, vector<Quadrilateral>& quadrilateral, QuadScratch& scratch, int scale);
   *
   * @param img 		One chanel image for that we will retrieve the curve of points.
   *
   * @param quadrilatera A vector of approximate quadrilateral.
+  *
+  * @param scratch	Buffers for the contours and the scores, reused for every image.
+  *
+  * @param scale	How many times `img` is smaller than the frame. The
+  *			minimum area shrinks with it.
   */
-void get_good_quadrilaterals (Mat& img, vector<Quadrilateral>& quadrilateral){
+void get_good_quadrilaterals (Mat& img, vector<Quadrilateral>& quadrilateral, QuadScratch& scratch, int scale){
 	// Vector of 
 	//  Vector of Points that represents one curve of points.
-	vector<vector<Point> > contours0;
+	vector<vector<Point> >& contours0 = scratch.curves;
 
 	// dumb vector for the findContours function
-	vector<Vec4i> hierarchy;
+	vector<Vec4i>& hierarchy = scratch.hierarchy;
 
 	DEBUG("Find contours", 3);
 	// OpenCV function that returns all curves of points to `countors0`
-	findContours(img, contours0, hierarchy, RETR_TREE, CHAIN_APPROX_SIMPLE);
+	{
+		ScopedTimer timer ( Timing::CONTOURS );
+		findContours(img, contours0, hierarchy, RETR_TREE, CHAIN_APPROX_SIMPLE);
+	}
+
+	ScopedTimer timer ( Timing::QUAD_FIT );
 
 	DEBUG("For every curve of points...", 3);
 	for( size_t i=0; i< contours0.size(); i++ ){
@@ -269,12 +312,12 @@ void get_good_quadrilaterals (Mat& img, vector<Quadrilateral>& quadrilateral){
 			Quadrilateral q; 
 
 			DEBUG("get the approximative quadrilateral", 4);
-			approximate_quadrilateral ( contours0[i], q );
+			approximate_quadrilateral ( contours0[i], q, scratch.rdp );
 
 			DEBUG("Area: ", 4);			
 			DEBUG(q.area(), 5);
 			// if the area of quadrilateral is big enouth
-			if ( q.area() > QUADRILATERAL_AREA_THRESHOLD ){
+			if ( q.area() > QUADRILATERAL_AREA_THRESHOLD / (float) (scale*scale) ){
 
 				DEBUG("\"sort\" the points based on center", 4);
 				sort_point_based_on_center (q);
@@ -286,6 +329,54 @@ void get_good_quadrilaterals (Mat& img, vector<Quadrilateral>& quadrilateral){
 	}
 }
 
+/** @fn void refine_quadrilateral ( const Mat& mask, Quadrilateral& q, int radius )
+  *
+  * @brief	Moves every corner of `q` to the pixel of `mask` around it
+  *		that goes farthest out of the quadrilateral.
+  *
+  * Meant for corners found in a smaller image and scaled back: in a
+  * window of `radius` pixels around the corner, the non zero pixel of
+  * `mask` farthest along the direction from the center of `q` to the
+  * corner becomes the corner. Ties go to the closest one.
+  *
+  * @param mask		One channel mask at the resolution of `q`.
+  * @param radius	Half the side of the window, the tolerance of the corners.
+  */
+void refine_quadrilateral ( const Mat& mask, Quadrilateral& q, int radius ){
+	Point2f c (0, 0);
+	for( size_t i=0; i<q.size(); i++ ){
+		c.x += q[i].x;
+		c.y += q[i].y;
+	}
+	c.x /= q.size();
+	c.y /= q.size();
+
+	for( size_t i=0; i<q.size(); i++ ){
+		const Point corner = q[i];
+		const Point2f dir = Point2f(corner) - c;
+
+		const int x0 = max( corner.x - radius, 0 ), x1 = min( corner.x + radius, mask.cols - 1 );
+		const int y0 = max( corner.y - radius, 0 ), y1 = min( corner.y + radius, mask.rows - 1 );
+
+		float best = -FLT_MAX;
+		int best_dist = INT_MAX;
+		for( int y=y0; y<=y1; y++ ){
+			const uchar* ptr = mask.ptr<uchar>(y);
+			for( int x=x0; x<=x1; x++ ){
+				if( !ptr[x] ) continue;
+
+				float out = (x - c.x)*dir.x + (y - c.y)*dir.y;
+				int dist = (x - corner.x)*(x - corner.x) + (y - corner.y)*(y - corner.y);
+				if( out > best || ( out == best && dist < best_dist ) ){
+					best = out;
+					best_dist = dist;
+					q[i] = Point(x, y);
+				}
+			}
+		}
+	}
+}
+
 //--REPLACE_THE_IMAGE---------------------------------------------------------------
 
 /** @fn 	void mask ( const Mat& src, Mat& dst, const Mat& mask)
@@ -316,57 +407,359 @@ void 	mask ( const Mat& src, Mat& dst, const Mat& mask){
 	}
 }
 
+/** @fn static bool quadrilateral_span ( const Point2f p[], float y0, float y1, float& xl, float& xr )
+  *
+  * @brief	Leftmost and rightmost x of the quadrilateral `p` between the
+  *		lines y0 and y1.
+  *
+  * @return	Whether the quadrilateral reaches those lines at all.
+  */
+static bool quadrilateral_span ( const Point2f p[], float y0, float y1, float& xl, float& xr ){
+	xl = FLT_MAX;
+	xr = -FLT_MAX;
+
+	for ( int k=0; k<QUADRILATERAL_SIZE; k++ ){
+		Point2f a = p[k], b = p[(k+1) % QUADRILATERAL_SIZE];
+		if( a.y > b.y ) swap( a, b );
+		if( b.y < y0 || a.y > y1 ) continue;
+
+		// The part of the edge between the lines
+		float ta = a.y < y0 ? (y0 - a.y) / (b.y - a.y) : 0.f;
+		float tb = b.y > y1 ? (y1 - a.y) / (b.y - a.y) : 1.f;
+		float xa = a.x + (b.x - a.x)*ta;
+		float xb = a.x + (b.x - a.x)*tb;
+
+		xl = min( xl, min(xa, xb) );
+		xr = max( xr, max(xa, xb) );
+	}
+
+	return xl <= xr;
+}
+
+//! A quadrilateral of replace_quadrilaterals_by_image, and its span in the current row.
+struct QuadWarp {
+	Point2f p[QUADRILATERAL_SIZE];
+	double h[9];		// from the ROI to image_to_put
+	int y_begin, y_end;	// rows its grown span reaches
+	float xl, xr;		// its span in the row, xl > xr if none
+	double u, v, w;		// h applied to x = 0 of the row
+};
+
 /**
-  * @fn 	void replace_quadrilateral_by_image ( Mat& original, Mat& image_to_put, Quadrilateral &q )
-  * @brief 	Replace, in the original image, the quadrilateral q by image_to_put.
+  * @fn 	void replace_quadrilaterals_by_image ( Mat& original, const Mat& image_to_put, const Mat& _mask, vector<Quadrilateral>& q )
+  * @brief 	Replace, in the original image, every quadrilateral of q by image_to_put.
+  *
+  * The ROI mask is walked once, whatever the number of quadrilaterals.
+  * A pixel that is 127 in it belongs to the nearest quadrilateral whose
+  * span in the row, grown by REPLACE_QUAD_MARGIN, takes it; it is mapped
+  * back to image_to_put with that one's homography and sampled there,
+  * bilinear with the border replicated, like warpPerspective. The green
+  * no quadrilateral takes is sampled with the last one, as the warp of
+  * the last quadrilateral over the whole ROI used to leave it.
   *
   * @param original 	The image to be putted in.
   * @param image_to_put	Image to put.
-  * @param q		The quadrilateral.
+  * @param _mask	Where `original` can be replaced: the pixels with 127.
+  * @param q		The quadrilaterals of the ROI.
   *
   */
-void replace_quadrilateral_by_image ( Mat& original, Mat& image_to_put, Mat& _mask, Quadrilateral &q ){
-	vector<Point2f> frame_point;
-	vector<Point2f> quadrilateral_point;
-	frame_point.push_back( Point2f(0, 0) );
-	frame_point.push_back( Point2f(image_to_put.cols, 0) );
-	frame_point.push_back( Point2f(image_to_put.cols, image_to_put.rows) );
-	frame_point.push_back( Point2f(0, image_to_put.rows) );
+void replace_quadrilaterals_by_image ( Mat& original, const Mat& image_to_put, const Mat& _mask, vector<Quadrilateral>& q ){
+	if( q.empty() )
+		return;
+
+	ScopedTimer timer ( Timing::WARP_COMPOSITE );
+
+	const Point2f frame_point[QUADRILATERAL_SIZE] = {
+		Point2f(0, 0),
+		Point2f(image_to_put.cols, 0),
+		Point2f(image_to_put.cols, image_to_put.rows),
+		Point2f(0, image_to_put.rows)
+	};
+
+	const int M = REPLACE_QUAD_MARGIN;
+	static thread_local vector <QuadWarp> warps;
+	warps.resize( q.size() );
+
+	for ( size_t j=0; j<q.size(); j++ ){
+		QuadWarp& warp = warps[j];
+		float min_y = FLT_MAX, max_y = -FLT_MAX;
+		for ( size_t i=0; i<q[j].size(); i++ ){
+			warp.p[i] = q[j][i];
+			min_y = min( min_y, warp.p[i].y );
+			max_y = max( max_y, warp.p[i].y );
+		}
+
+		// From the quadrilateral to the image: the inverse of the warp
+		Mat transmtx = getPerspectiveTransform( warp.p, frame_point );
+		copy( transmtx.ptr<double>(), transmtx.ptr<double>() + 9, warp.h );
+
+		warp.y_begin = (int) floor(min_y) - M;
+		warp.y_end   = (int) ceil(max_y) + M;
+	}
 
-	for(size_t i=0; i<q.size(); i++)
-		quadrilateral_point.push_back( q[i] );
+	const float last_x = image_to_put.cols - 1;
+	const float last_y = image_to_put.rows - 1;
+
+	for ( int y = 0; y < original.rows; y++ ){
+		const uchar* ptr_mask = _mask.ptr<uchar>(y);
+		uchar* ptr_dst = original.ptr<uchar>(y);
+
+		for ( size_t j=0; j<warps.size(); j++ ){
+			QuadWarp& warp = warps[j];
+			if( y < warp.y_begin || y > warp.y_end ||
+			    !quadrilateral_span( warp.p, y - M, y + M, warp.xl, warp.xr ) ){
+				warp.xl = 1.f;
+				warp.xr = 0.f;
+			}
+
+			warp.u = warp.h[1]*y + warp.h[2];
+			warp.v = warp.h[4]*y + warp.h[5];
+			warp.w = warp.h[7]*y + warp.h[8];
+		}
 
+		for ( int x = 0; x < original.cols; x++ ){
+			if( ptr_mask[x] != 127 )
+				continue;
 
-	Mat transmtx = getPerspectiveTransform( frame_point, quadrilateral_point );
+			// The nearest span of the row within the margin, or the last quadrilateral
+			const QuadWarp* owner = &warps.back();
+			float nearest = FLT_MAX;
+			for ( size_t j=0; j<warps.size(); j++ ){
+				if( warps[j].xl > warps[j].xr )
+					continue;
+				float d = max( max( warps[j].xl - x, x - warps[j].xr ), 0.f );
+				if( d <= M && d < nearest ){
+					nearest = d;
+					owner = &warps[j];
+				}
+			}
 
-	Mat replaced_quad;
-	warpPerspective( image_to_put, replaced_quad, transmtx, original.size(), INTER_LINEAR, BORDER_REPLICATE );
-	mask( replaced_quad, original, _mask );
+			const double* h = owner->h;
+			double u = owner->u + h[0]*x;
+			double v = owner->v + h[3]*x;
+			double w = owner->w + h[6]*x;
+
+			// As warpPerspective, the points at infinity go to the origin
+			double iw = w ? 1./w : 0;
+
+			// Clamping the point replicates the border
+			float sx = (float) min( max( u*iw, 0. ), (double) last_x );
+			float sy = (float) min( max( v*iw, 0. ), (double) last_y );
+			int x0 = (int) sx, y0 = (int) sy;
+			int x1 = min( x0 + 1, image_to_put.cols - 1 );
+			int y1 = min( y0 + 1, image_to_put.rows - 1 );
+			float fx = sx - x0, fy = sy - y0;
+
+			const uchar* p00 = image_to_put.ptr<uchar>(y0) + x0*image_to_put.channels();
+			const uchar* p01 = image_to_put.ptr<uchar>(y0) + x1*image_to_put.channels();
+			const uchar* p10 = image_to_put.ptr<uchar>(y1) + x0*image_to_put.channels();
+			const uchar* p11 = image_to_put.ptr<uchar>(y1) + x1*image_to_put.channels();
+
+			uchar* dst = ptr_dst + x*original.channels();
+			for ( int c = Color::B; c <= Color::R; c++ ){
+				float top = p00[c] + (p01[c] - p00[c])*fx;
+				float bot = p10[c] + (p11[c] - p10[c])*fx;
+				dst[c] = (uchar) ( top + (bot - top)*fy + 0.5f );
+			}
+		}
+	}
+}
 
+/**
+  * @fn 	void replace_quadrilateral_by_image ( Mat& original, const Mat& image_to_put, const Mat& _mask, Quadrilateral &q )
+  * @brief 	Replace, in the original image, the quadrilateral q by image_to_put.
+  *
+  * replace_quadrilaterals_by_image with q alone: every pixel that is 127
+  * in the mask gets its homography.
+  */
+void replace_quadrilateral_by_image ( Mat& original, const Mat& image_to_put, const Mat& _mask, Quadrilateral &q ){
+	vector<Quadrilateral> alone ( 1, q );
+	replace_quadrilaterals_by_image( original, image_to_put, _mask, alone );
 }
 
 //--ROI management--------------------------------------------
-void find_connected_components (Mat& img, vector <Rect>& out)
+
+/** @fn void find_connected_components ( Mat& img, vector<Blob>& out )
+  *
+  * @brief	Finds every blob of 255 in `img`, in one sweep, and paints
+  *		them with 127.
+  *
+  * @param out	All the blobs, with bounding rectangle and area.
+  */
+void find_connected_components (Mat& img, vector <Blob>& out)
+{
+	// One labeler per thread, so the buffers are reused between frames
+	static thread_local ComponentLabeler labeler;
+
+	ScopedTimer timer (Timing::LABEL);
+	labeler.label (img, out);
+}
+
+/** @fn void find_connected_components ( Mat& img, vector<Rect>& out, int scale )
+  *
+  * @brief	Bounding rectangles of the blobs big enough to be a card.
+  *
+  * @param scale	How many times `img` is smaller than the frame. The
+  *			minimum number of pixels shrinks with it.
+  */
+void find_connected_components (Mat& img, vector <Rect>& out, int scale)
 {
-	// Percorre a imagem. Aqui, não dá para usar o nosso truquezinho (você consegue descobrir o motivo?).
-	for (int row = 0; row < img.rows; row++)
+	static thread_local vector <Blob> blobs;
+	find_connected_components (img, blobs);
+
+	// Testezinhos simples...
+	for (size_t i = 0; i < blobs.size (); i++)
+		if (blobs [i].pixels * scale * scale >= ROI_MIN_PIXEL)
+			out.push_back (blobs [i].rect); // Guarda o retângulo envolvente deste blob.
+}
+
+//! Whether two rects share some area, like a non empty `a & b`.
+static inline bool overlaps (const Rect& a, const Rect& b)
+{
+	return a.x < b.x + b.width && b.x < a.x + a.width &&
+	       a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+/** @class RectGrid
+  *
+  * @brief Uniform grid over the image where every cell lists the rects
+  *	  that touch it, to find the rects that may overlap a given one
+  *	  without testing all of them.
+  */
+class RectGrid {
+public:
+	void reset (Size size, size_t n_rects)
+	{
+		// Around one rect per cell
+		cell = max ((int) sqrt ((double) size.area () / max (n_rects, (size_t) 1)), RECT_GRID_MIN_CELL);
+		cols = size.width / cell + 1;
+		rows = size.height / cell + 1;
+
+		cells.resize (cols * rows);
+		for (size_t i = 0; i < cells.size (); i++)
+			cells [i].clear ();
+	}
+
+	void insert (int id, const Rect& r)
 	{
-		unsigned char* ptr = (unsigned char*) img.data + (row * img.step);
-		for (int col = 0; col < img.cols; col++)
+		for (int y = cell_y (r.y); y <= cell_y (r.y + r.height - 1); y++)
+			for (int x = cell_x (r.x); x <= cell_x (r.x + r.width - 1); x++)
+				cells [y*cols + x].push_back (id);
+	}
+
+	/** Calls f(id) for the rects in the cells that touch `r`, skipping
+	  * the cells that are entirely inside `searched`. A rect may be
+	  * visited more than once. */
+	template <typename F>
+	void visit (const Rect& r, const Rect& searched, F f)
+	{
+		// Cells entirely inside `searched`, if any. The border cells also
+		// hold the rects clamped into them, so they are always searched.
+		int ix0 = max ((searched.x + cell - 1) / cell, 1);
+		int ix1 = min ((searched.x + searched.width) / cell - 1, cols - 2);
+		int iy0 = max ((searched.y + cell - 1) / cell, 1);
+		int iy1 = min ((searched.y + searched.height) / cell - 1, rows - 2);
+		if (searched.width <= 0 || searched.height <= 0 || searched.x < 0 || searched.y < 0)
+			ix1 = ix0 - 1;
+
+		int x0 = cell_x (r.x), x1 = cell_x (r.x + r.width - 1);
+		for (int y = cell_y (r.y); y <= cell_y (r.y + r.height - 1); y++)
 		{
-			if (*ptr == 255) // Encontrou um novo blob!
+			bool inner_row = iy0 <= y && y <= iy1 && ix0 <= ix1;
+			for (int x = x0; x <= x1; x++)
 			{
-				// Inunda a partir da posição atual. Todos os pixels do mesmo blob são marcados com o valor 127.
-				Rect out_rect;
-				int n_painted = floodFill (img, Point (col, row), Scalar (127), &out_rect);
-
-				// Testezinhos simples...
-				if (n_painted >= ROI_MIN_PIXEL)
-					out.push_back (out_rect); // Todos os testes realizados com sucesso. Guarda o retângulo envolvente deste blob.
+				if (inner_row && ix0 <= x && x <= ix1)
+					x = ix1 + 1;
+				if (x > x1)
+					break;
+
+				const vector <int>& c = cells [y*cols + x];
+				for (size_t k = 0; k < c.size (); k++)
+					f (c [k]);
 			}
+		}
+	}
+
+private:
+	int cell, cols, rows;
+	vector < vector <int> > cells;
+
+	int cell_x (int x) const { return min (max (x, 0) / cell, cols - 1); }
+	int cell_y (int y) const { return min (max (y, 0) / cell, rows - 1); }
+};
+
+/** @fn static void group_bounding_rects (vector <Rect>& rects, Size size)
+  *
+  * @brief	Merges the rects that overlap, transitively. Merged rects
+  *		get width 0 and the group is kept in one of them.
+  *
+  * This gives exactly the rects of the original loop, that for every
+  * rect `i` still alive restarted a scan over all the others after each
+  * merge. The scan is only needed to find "some alive rect overlapping
+  * the group", so the grid answers that, and only the cells the group
+  * grew into are searched again after each merge. As in the original
+  * loop, that restarted its scan at index 1, the rect 0 is only tested
+  * against a group before the group's first merge.
+  */
+static void group_bounding_rects (vector <Rect>& rects, Size size)
+{
+	static thread_local RectGrid grid;
+	static thread_local vector <int> seen;	// last search that saw each rect
+	static thread_local vector <int> found;
+
+	const int n = rects.size ();
+	seen.assign (n, -1);
+	int search = 0;
+
+	// Rects with no area never overlap anything, so they stay out of the
+	// grid. The rect 0 has its own test.
+	grid.reset (size, n);
+	for (int i = 1; i < n; i++)
+		if (rects [i].width > 0 && rects [i].height > 0)
+			grid.insert (i, rects [i]);
+
+	for (int i = 0; i < n; i++)
+	{
+		if (rects [i].width <= 0 || rects [i].height <= 0) // Already merged, or no area
+			continue;
 
-			ptr++;
+		Rect out_rect = rects [i];
+		if (i != 0 && rects [0].height > 0 && rects [0].width > 0 && overlaps (rects [0], out_rect))
+		{
+			out_rect |= rects [0];
+			rects [0].width = 0;
 		}
+
+		// Merge everything that overlaps the group, until it stops growing
+		Rect searched;
+		for (;;)
+		{
+			found.clear ();
+			grid.visit (out_rect, searched, [&] (int j) {
+				if (seen [j] == search)
+					return;
+				seen [j] = search;
+
+				if (j != i && rects [j].width > 0 && overlaps (rects [j], out_rect))
+					found.push_back (j);
+			});
+			search++;
+
+			if (found.empty ())
+				break;
+
+			searched = out_rect;
+			for (size_t k = 0; k < found.size (); k++)
+			{
+				out_rect |= rects [found [k]];
+				rects [found [k]].width = 0;
+			}
+		}
+
+		// The group may still be merged by a later rect
+		rects [i] = out_rect;
+		if (i != 0)
+			grid.insert (i, out_rect);
 	}
 }
 
@@ -398,32 +791,10 @@ void extend_and_group_bounding_rects (vector <Rect>& rects, Size size)
 	}
 
 	// Agrupa componentes.
-	vector <Rect> tmp_rects;
+	static thread_local vector <Rect> tmp_rects;
 	tmp_rects.assign (rects.begin (), rects.end ()); // Copia todos os retângulos para cá.
 
-	for (unsigned int i = 0; i < tmp_rects.size (); i++)
-	{
-		if (tmp_rects [i].width != 0) // Se este retângulo ainda não foi misturado com outro.
-		{
-			// Procura por outro componente com intersecção com este.
-			Rect out_rect = tmp_rects [i];
-			for (unsigned int j = 0; j < tmp_rects.size (); j++)
-			{
-				if (i == j || tmp_rects [j].width == 0) // Pula, se j for o mesmo Rect ou já tiver sido "engolido".
-					continue;
-
-				Rect intersection = tmp_rects [j] & out_rect; // Podemos usar & para obter a intersecção entre dois Rects.
-				if (intersection.width > 0)
-				{
-					out_rect |= tmp_rects [j]; // Podemos usar | para obter a união de dois Rects.
-					tmp_rects [j].width = 0;
-					j = 0; // Volta tudo!
-				}
-			}
-
-			tmp_rects [i] = out_rect;
-		}
-	}
+	group_bounding_rects (tmp_rects, size);
 
 	// Substitui.
 	rects.clear ();
@@ -432,3 +803,29 @@ void extend_and_group_bounding_rects (vector <Rect>& rects, Size size)
 			rects.push_back (tmp_rects [i]);
 }
 
+//--DRAW-------------------------------------------------------
+void draw_point ( Mat& frame, vector<Quadrilateral>& vec ){
+
+	Scalar s[4] = 	{
+				Scalar(255, 0, 0),
+				Scalar(0, 255, 0),
+				Scalar(0, 0, 255),
+				Scalar(0, 255, 255)
+			};
+
+	for(size_t i=0; i<vec.size(); i++){
+
+		for (size_t j=0; j< 4 ; j++){
+			circle(frame, vec[i][j], 4, s[j], 2);
+		}
+	}
+}
+
+void 	draw_point ( Mat& img, vector<Point>& vec, Scalar s ){
+	for(size_t i=0; i<vec.size(); i++){
+		for (size_t j=0; j< 4 ; j++){
+			circle(img, vec[i], 4, s, 2);
+		}
+	}
+
+}
@@ -0,0 +1,111 @@
+/** @file async_writer.cpp
+  * @brief writes frames to disk in a thread of its own, from a bounded set of buffers.
+  */
+//--INCLUDES--------------------------------------------------
+#include <async_writer.hpp>
+
+#include <algorithm>
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+/** @fn AsyncWriter::AsyncWriter ( size_t depth )
+  *
+  * @brief	Starts the writer with `depth` buffers, at least one more
+  *		than the reserve so DROP jobs get one too.
+  */
+AsyncWriter::AsyncWriter ( size_t depth ) :
+	buffers ( max( depth, (size_t) ASYNC_WRITER_RESERVE + 1 ) ),
+	queue ( buffers.size() ),
+	first ( 0 ), count ( 0 ), busy ( false ), stopping ( false ),
+	n_written ( 0 ), n_dropped ( 0 ){
+
+	for ( size_t i = buffers.size(); i-- > 0; )
+		idle.push_back( i );
+
+	thread = std::thread( &AsyncWriter::run, this );
+}
+
+//! Writes what is in the queue, then stops the writer.
+AsyncWriter::~AsyncWriter (){
+	{
+		lock_guard<mutex> guard ( lock );
+		stopping = true;
+	}
+	ready.notify_all();
+	thread.join();
+}
+
+/** @fn bool AsyncWriter::submit ( const Mat& frame, const Job& job, Policy policy )
+  *
+  * @brief	Copies `frame` to an idle buffer and queues it for `job`.
+  *
+  * The copy is made with no lock held: a buffer out of the idle list
+  * and not in the queue belongs to this call only.
+  *
+  * @return	false if a DROP job found no buffer and was dropped.
+  */
+bool AsyncWriter::submit ( const Mat& frame, const Job& job, Policy policy ){
+	const size_t reserve = policy == DROP ? ASYNC_WRITER_RESERVE : 0;
+	size_t i;
+
+	{
+		unique_lock<mutex> guard ( lock );
+		if( policy == WAIT )
+			done.wait( guard, [this]{ return !idle.empty(); } );
+		else if( idle.size() <= reserve ){
+			n_dropped++;
+			return false;
+		}
+
+		i = idle.back();
+		idle.pop_back();
+	}
+
+	Buffer& buffer = buffers[i];
+	frame.copyTo( buffer.frame );
+	buffer.job = job;
+
+	{
+		lock_guard<mutex> guard ( lock );
+		queue[( first + count ) % queue.size()] = i;
+		count++;
+	}
+	ready.notify_one();
+	return true;
+}
+
+//! Waits until every frame submitted before was written.
+void AsyncWriter::flush (){
+	unique_lock<mutex> guard ( lock );
+	done.wait( guard, [this]{ return !count && !busy; } );
+}
+
+//! The thread of the writer: the jobs of the queue, in order.
+void AsyncWriter::run (){
+	unique_lock<mutex> guard ( lock );
+
+	for( ;; ){
+		ready.wait( guard, [this]{ return count || stopping; } );
+		if( !count )
+			break;
+
+		size_t i = queue[first];
+		first = ( first + 1 ) % queue.size();
+		count--;
+		busy = true;
+
+		// Encoding and disk, with no lock held
+		guard.unlock();
+		Buffer& buffer = buffers[i];
+		buffer.job( buffer.frame );
+		buffer.job = Job();
+		guard.lock();
+
+		idle.push_back( i );
+		busy = false;
+		n_written++;
+		done.notify_all();
+	}
+}
@@ -0,0 +1,355 @@
+/** @file bit_mask.cpp
+  * @brief binary mask with one bit per pixel, and its median blur and dilation on whole words.
+  */
+//--INCLUDES--------------------------------------------------
+#include <bit_mask.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//--MACROS----------------------------------------------------
+// Bit planes of the counts: up to BIT_MASK_MAX_WINDOW^2
+#define MAX_PLANES	12
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+//--ROWS------------------------------------------------------
+
+/** @fn void pack_row ( const uchar* src, uint64_t* dst, int n )
+  *
+  * @brief	One bit for every one of the `n` bytes of `src`, set if the
+  *		byte is not zero. The bits past `n`, in the last word, are
+  *		zero.
+  */
+void pack_row ( const uchar* src, uint64_t* dst, int n ){
+	int x = 0;
+
+	#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	for ( ; x + BIT_MASK_WORD <= n; x += BIT_MASK_WORD, src += BIT_MASK_WORD ){
+		// The bytes equal to zero, 16 at a time, the other ones set
+		uint64_t w = 0;
+		for ( int k = 0; k < BIT_MASK_WORD; k += 16 ){
+			__m128i is_zero = _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i*) (src + k) ), zero );
+			w |= (uint64_t) (uint16_t) ~_mm_movemask_epi8( is_zero ) << k;
+		}
+		*dst++ = w;
+	}
+	#endif
+
+	for ( ; x < n; x += BIT_MASK_WORD ){
+		const int m = min( n - x, BIT_MASK_WORD );
+		uint64_t w = 0;
+		for ( int k = 0; k < m; k++ )
+			w |= (uint64_t) ( src[k] != 0 ) << k;
+		*dst++ = w;
+		src += m;
+	}
+}
+
+/** @fn void unpack_row ( const uint64_t* src, uchar* dst, int n, uchar one )
+  *
+  * @brief	`n` bytes from the bits of `src`: `one` where it is set, 0
+  *		elsewhere.
+  */
+void unpack_row ( const uint64_t* src, uchar* dst, int n, uchar one ){
+	int x = 0;
+
+	#ifdef __SSE2__
+	// Byte k of a half tests the bit k%8 of its byte of the word
+	const __m128i select = _mm_set1_epi64x( 0x8040201008040201ll );
+	const __m128i value = _mm_set1_epi8( (char) one );
+	for ( ; x + BIT_MASK_WORD <= n; x += BIT_MASK_WORD, dst += BIT_MASK_WORD ){
+		const uint64_t w = *src++;
+		for ( int k = 0; k < BIT_MASK_WORD; k += 16 ){
+			// Every byte of the low half gets the byte k/8 of the word, and of the high half the next one
+			const uint64_t lo = ( w >> k ) & 0xFF, hi = ( w >> (k + 8) ) & 0xFF;
+			__m128i bytes = _mm_set_epi64x( (long long) ( hi * 0x0101010101010101ull ),
+							(long long) ( lo * 0x0101010101010101ull ) );
+			__m128i set = _mm_cmpeq_epi8( _mm_and_si128( bytes, select ), select );
+			_mm_storeu_si128( (__m128i*) (dst + k), _mm_and_si128( set, value ) );
+		}
+	}
+	#endif
+
+	for ( ; x < n; x += BIT_MASK_WORD ){
+		const int m = min( n - x, BIT_MASK_WORD );
+		const uint64_t w = *src++;
+		for ( int k = 0; k < m; k++ )
+			*dst++ = ( w >> k ) & 1 ? one : 0;
+	}
+}
+
+//--BIT_MASK--------------------------------------------------
+
+//! Makes the mask `size`, keeping the storage if it is big enough. The bits are undefined.
+void BitMask::create ( Size size ){
+	width = size.width;
+	height = size.height;
+	stride = ( width + BIT_MASK_WORD - 1 ) / BIT_MASK_WORD;
+
+	const size_t n = (size_t) stride * height;
+	if( bits.size() < n )
+		bits.resize( n );
+}
+
+//! The mask of the pixels of `mask` (CV_8UC1) that are not zero.
+void BitMask::pack ( const Mat& mask ){
+	create( mask.size() );
+	for ( int y = 0; y < height; y++ )
+		pack_row( mask.ptr<uchar>(y), row(y), width );
+}
+
+//! `mask` of the same size, CV_8UC1, with `one` where the bit is set and 0 elsewhere.
+void BitMask::unpack ( Mat& mask, uchar one ) const {
+	mask.create( size(), CV_8UC1 );
+	unpack ( mask, Rect( Point(0, 0), size() ), one );
+}
+
+/** @fn void BitMask::unpack ( Mat& mask, Rect area, uchar one ) const
+  *
+  * @brief	Only the rows of `area` and the words of its columns, in a
+  *		`mask` that already has the size of this one.
+  */
+void BitMask::unpack ( Mat& mask, Rect area, uchar one ) const {
+	area &= Rect( Point(0, 0), size() );
+	if( area.area() == 0 )
+		return;
+
+	const int w0 = area.x / BIT_MASK_WORD;
+	const int x0 = w0 * BIT_MASK_WORD;
+	const int x1 = min( width, ( area.x + area.width + BIT_MASK_WORD - 1 ) / BIT_MASK_WORD * BIT_MASK_WORD );
+
+	for ( int y = area.y; y < area.y + area.height; y++ )
+		unpack_row( row(y) + w0, mask.ptr<uchar>(y) + x0, x1 - x0, one );
+}
+
+//--MORPHOLOGY------------------------------------------------
+
+/** @fn static Rect words_of ( const BitMask& mask, Rect area, int& w0, int& w1 )
+  *
+  * @return	`area` inside `mask`, or all of it if `area` is empty, with
+  *		the first word and one past the last of its columns in `w0`
+  *		and `w1`.
+  */
+static Rect words_of ( const BitMask& mask, Rect area, int& w0, int& w1 ){
+	const Rect whole ( Point(0, 0), mask.size() );
+	area = area.area() ? area & whole : whole;
+
+	w0 = area.x / BIT_MASK_WORD;
+	w1 = ( area.x + area.width + BIT_MASK_WORD - 1 ) / BIT_MASK_WORD;
+	return area;
+}
+
+//! Adds the bits of `b` to the counters of `planes`, one per column.
+static inline void add_bits ( uint64_t* const* planes, int n_planes, int w, uint64_t b ){
+	for ( int p = 0; p < n_planes && b; p++ ){
+		const uint64_t carry = planes[p][w] & b;
+		planes[p][w] ^= b;
+		b = carry;
+	}
+}
+
+//! Subtracts the bits of `b` from the counters of `planes`, one per column.
+static inline void sub_bits ( uint64_t* const* planes, int n_planes, int w, uint64_t b ){
+	for ( int p = 0; p < n_planes && b; p++ ){
+		const uint64_t borrow = ~planes[p][w] & b;
+		planes[p][w] ^= b;
+		b = borrow;
+	}
+}
+
+/** @fn static inline uint64_t shifted ( const uint64_t* plane, int w, int dx )
+  *
+  * @return	The word `w` of `plane` as if it started `dx` bits later:
+  *		bit x of the result is the bit x + dx of the row. The row has
+  *		a word of padding on each side.
+  */
+static inline uint64_t shifted ( const uint64_t* plane, int w, int dx ){
+	if( dx > 0 )
+		return ( plane[w] >> dx ) | ( plane[w + 1] << ( BIT_MASK_WORD - dx ) );
+	if( dx < 0 )
+		return ( plane[w] << -dx ) | ( plane[w - 1] >> ( BIT_MASK_WORD + dx ) );
+	return plane[w];
+}
+
+/** @fn void bit_median ( const BitMask& src, BitMask& dst, int window, Rect area )
+  *
+  * @brief	The medianBlur() of a mask of 0 and 255, with the same
+  *		replicated border: a pixel is set if the majority of the
+  *		window x window pixels around it is.
+  *
+  * Bit-sliced: a count of the set pixels of every column is kept in bit
+  * planes, one word for 64 columns per bit of the count, and slides down
+  * the rows adding the new row and subtracting the old one. The counts
+  * of the neighbour columns are then added to them shifted, 64 columns
+  * at a time, and compared with the majority, without ever counting a
+  * pixel alone.
+  *
+  * @param window	Odd, up to BIT_MASK_MAX_WINDOW.
+  *
+  * @param area		Only these pixels, and the rest of their words, are
+  *			computed; empty for the whole mask. The rest of `dst`
+  *			is left as it is.
+  */
+void bit_median ( const BitMask& src, BitMask& dst, int window, Rect area ){
+	CV_Assert( window % 2 == 1 && window <= BIT_MASK_MAX_WINDOW && &src != &dst );
+
+	const int r = window / 2;
+	const int rows = src.size().height;
+	const int words = src.words();
+	const int majority = window * window / 2 + 1;
+
+	int w0, w1;
+	area = words_of( src, area, w0, w1 );
+	if( area.area() == 0 )
+		return;
+
+	if( dst.size() != src.size() )
+		dst.create( src.size() );
+
+	// Bits of the counts: of a column, and of the whole window
+	int column_planes = 1, window_planes = 1;
+	while( ( 1 << column_planes ) <= window )
+		column_planes++;
+	while( ( 1 << window_planes ) <= window * window )
+		window_planes++;
+
+	// Counts of the columns, with a word of padding on each side
+	static thread_local vector<uint64_t> storage;
+	const int padded = words + 2;
+	if( storage.size() < (size_t) column_planes * padded )
+		storage.resize( (size_t) column_planes * padded );
+
+	uint64_t* planes[MAX_PLANES];
+	for ( int p = 0; p < column_planes; p++ ){
+		planes[p] = &storage[ (size_t) p * padded + 1 ];
+		fill( planes[p] + w0 - 1, planes[p] + w1 + 1, 0 );
+	}
+
+	// Their neighbours are needed too
+	const int c0 = max( w0 - 1, 0 ), c1 = min( w1 + 1, words );
+	auto clamp_row = [rows] ( int y ){ return min( max( y, 0 ), rows - 1 ); };
+
+	// The window of the first row, with its top rows replicated
+	for ( int dy = -r; dy <= r; dy++ ){
+		const uint64_t* in = src.row( clamp_row( area.y + dy ) );
+		for ( int w = c0; w < c1; w++ )
+			add_bits( planes, column_planes, w, in[w] );
+	}
+
+	const int last = src.size().width - 1;
+	const uint64_t above_last = ( last + 1 ) % BIT_MASK_WORD ? ~0ull << ( ( last + 1 ) % BIT_MASK_WORD ) : 0;
+
+	for ( int y = area.y; y < area.y + area.height; y++ ){
+		if( y > area.y ){
+			const uint64_t* out = src.row( clamp_row( y - r - 1 ) );
+			const uint64_t* in = src.row( clamp_row( y + r ) );
+			for ( int w = c0; w < c1; w++ ){
+				sub_bits( planes, column_planes, w, out[w] );
+				add_bits( planes, column_planes, w, in[w] );
+			}
+		}
+
+		// The columns out of the mask replicate the first and the last one
+		for ( int p = 0; p < column_planes; p++ ){
+			if( w0 == 0 )
+				planes[p][-1] = planes[p][0] & 1 ? ~0ull : 0;
+			if( c1 == words ){
+				uint64_t& tail = planes[p][words - 1];
+				const bool set = ( tail >> ( last % BIT_MASK_WORD ) ) & 1;
+				tail = set ? tail | above_last : tail & ~above_last;
+				planes[p][words] = set ? ~0ull : 0;
+			}
+		}
+
+		uint64_t* out = dst.row( y );
+		for ( int w = w0; w < w1; w++ ){
+			// Sum of the counts of the columns x-r to x+r, for every x of the word
+			uint64_t sum[MAX_PLANES] = { 0 };
+			for ( int dx = -r; dx <= r; dx++ ){
+				uint64_t carry = 0;
+				for ( int p = 0; p < window_planes; p++ ){
+					const uint64_t a = p < column_planes ? shifted( planes[p], w, dx ) : 0;
+					if( p >= column_planes && !carry )
+						break;
+
+					const uint64_t s = sum[p];
+					sum[p] = s ^ a ^ carry;
+					carry = ( s & a ) | ( carry & ( s ^ a ) );
+				}
+			}
+
+			// sum >= majority, from the highest bit down
+			uint64_t greater = 0, equal = ~0ull;
+			for ( int p = window_planes - 1; p >= 0; p-- ){
+				if( ( majority >> p ) & 1 )
+					equal &= sum[p];
+				else{
+					greater |= equal & sum[p];
+					equal &= ~sum[p];
+				}
+			}
+			out[w] = greater | equal;
+		}
+	}
+}
+
+/** @fn void bit_dilate ( const BitMask& src, BitMask& dst, int size, Rect area )
+  *
+  * @brief	The dilate() by a size x size square, anchored at its center
+  *		as dilate() does: a pixel is set if any one from size/2
+  *		pixels above and to its left to (size-1)/2 below and to its
+  *		right is. Out of the mask there is none.
+  *
+  * @param area		As in bit_median().
+  */
+void bit_dilate ( const BitMask& src, BitMask& dst, int size, Rect area ){
+	CV_Assert( size >= 1 && size <= BIT_MASK_WORD && &src != &dst );
+
+	const int before = size / 2, after = size - 1 - before;
+	const int rows = src.size().height;
+	const int words = src.words();
+
+	int w0, w1;
+	area = words_of( src, area, w0, w1 );
+	if( area.area() == 0 )
+		return;
+
+	if( dst.size() != src.size() )
+		dst.create( src.size() );
+
+	// The rows of the window or-ed, with a word of nothing on each side
+	static thread_local vector<uint64_t> storage;
+	if( storage.size() < (size_t) words + 2 )
+		storage.resize( words + 2 );
+	uint64_t* v = &storage[1];
+
+	const int c0 = max( w0 - 1, 0 ), c1 = min( w1 + 1, words );
+	v[c0 - 1] = v[c1] = 0;
+
+	// The bits past the width of the last word are not pixels
+	const int tail = src.size().width % BIT_MASK_WORD;
+	const uint64_t valid = tail ? ( 1ull << tail ) - 1 : ~0ull;
+
+	for ( int y = area.y; y < area.y + area.height; y++ ){
+		fill( v + c0, v + c1, 0 );
+		for ( int yy = max( y - before, 0 ); yy <= min( y + after, rows - 1 ); yy++ )
+			for ( int w = c0; w < c1; w++ )
+				v[w] |= src.row( yy )[w];
+		if( c1 == words )
+			v[words - 1] &= valid;
+
+		uint64_t* out = dst.row( y );
+		for ( int w = w0; w < w1; w++ ){
+			uint64_t d = v[w];
+			for ( int dx = -before; dx <= after; dx++ )
+				if( dx )
+					d |= shifted( v, w, dx );
+			out[w] = d;
+		}
+	}
+}
@@ -0,0 +1,102 @@
+/** @file frame_history.cpp
+  * @brief the processed frames of the past, shared with the frame ring instead of copied.
+  */
+//--INCLUDES--------------------------------------------------
+#include <frame_history.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+/** @fn FrameHistory::FrameHistory ( size_t delay, size_t in_flight, size_t budget )
+  *
+  * @param delay	How many frames ago is the past, at least one.
+  * @param in_flight	Frames that may be between the processing and the
+  *			end of the output, the depth of the frame ring.
+  * @param budget	Bytes for the entries, 0 for no limit. It is never
+  *			less than the `in_flight` newest at full size.
+  */
+FrameHistory::FrameHistory ( size_t delay, size_t in_flight, size_t budget ) :
+	past_delay ( max( delay, (size_t) 1 ) ), in_flight ( max( in_flight, (size_t) 1 ) ), budget ( budget ){
+
+	keep = max( past_delay, this->in_flight );
+	full = keep;
+}
+
+/** @fn void FrameHistory::take ( Mat& frame )
+  *
+  * @brief	Gives `frame` a buffer of the same size and type that left
+  *		the history, or a new one. Its old buffer is just dropped:
+  *		it may still be in the history.
+  */
+void FrameHistory::take ( Mat& frame ){
+	lock_guard<mutex> guard ( lock );
+
+	if( !free_full.empty() && free_full.back().size() == frame.size() && free_full.back().type() == frame.type() ){
+		frame = free_full.back();
+		free_full.pop_back();
+	}else
+		frame = Mat( frame.size(), frame.type() );
+}
+
+/** @fn void FrameHistory::push ( const Mat& frame )
+  *
+  * @brief	`frame` is the newest entry now, with no copy. Its buffer
+  *		must not be changed anymore.
+  */
+void FrameHistory::push ( const Mat& frame ){
+	lock_guard<mutex> guard ( lock );
+
+	// The budget is only known in frames with the first one
+	if( budget && entries.empty() ){
+		size_t frame_bytes = frame.total() * frame.elemSize();
+		size_t small_bytes = frame_bytes / ( FRAME_HISTORY_SMALL_SCALE * FRAME_HISTORY_SMALL_SCALE );
+		size_t all_small = keep * small_bytes;
+
+		full = budget > all_small ? ( budget - all_small ) / ( frame_bytes - small_bytes ) : 0;
+		full = min( max( full, in_flight ), keep );
+	}
+
+	entries.push_front( frame );
+
+	// The one that just got too old for full size
+	if( full < keep && entries.size() > full ){
+		Mat& old = entries[full];
+
+		Mat small;
+		if( !free_small.empty() ){
+			small = free_small.back();
+			free_small.pop_back();
+		}
+		resize( old, small, Size( old.cols / FRAME_HISTORY_SMALL_SCALE, old.rows / FRAME_HISTORY_SMALL_SCALE ), 0, 0, INTER_AREA );
+
+		free_full.push_back( old );
+		old = small;
+	}
+
+	// The one that left
+	if( entries.size() > keep ){
+		Mat& gone = entries.back();
+		( gone.size() == frame.size() ? free_full : free_small ).push_back( gone );
+		entries.pop_back();
+	}
+
+	// A capture that never takes, as a replay, would pile them up
+	if( free_full.size() > in_flight )
+		free_full.erase( free_full.begin() );
+}
+
+/** @fn Mat FrameHistory::past ()
+  *
+  * @return	The frame pushed delay() frames ago, maybe smaller than the
+  *		others, or an empty Mat if there is none yet.
+  */
+Mat FrameHistory::past (){
+	lock_guard<mutex> guard ( lock );
+
+	if( entries.size() < past_delay )
+		return Mat();
+	return entries[past_delay - 1];
+}
@@ -0,0 +1,98 @@
+/** @file frame_ring.cpp
+  * @brief bounded ring of preallocated frames shared by the capture, processing and output threads.
+  */
+//--INCLUDES--------------------------------------------------
+#include <frame_ring.hpp>
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+/** @fn FrameRing::FrameRing ( size_t depth, Size size, int type )
+  *
+  * @param depth	Number of slots, at least one.
+  * @param size		Size of the frames, to preallocate the slots.
+  * @param type		Type of the frames, to preallocate the slots.
+  */
+FrameRing::FrameRing ( size_t depth, Size size, int type ) :
+	slots ( max( depth, (size_t) 1 ) ), closed ( false ), aborted ( false ){
+
+	for ( size_t i = 0; i < slots.size(); i++ ){
+		slots[i].frame.create( size, type );
+		slots[i].index = -1;
+	}
+
+	for ( int s = 0; s < Stage::N_STAGES; s++ )
+		done[s] = 0;
+}
+
+/** @fn FrameSlot* FrameRing::acquire ( Stage::FrameStage stage )
+  *
+  * @brief	Waits for the next slot of `stage`.
+  *
+  * @return	The slot, or NULL if there will be nothing else for this stage.
+  */
+FrameSlot* FrameRing::acquire ( Stage::FrameStage stage ){
+	unique_lock<mutex> guard ( lock );
+
+	for(;;){
+		if( aborted )
+			return NULL;
+
+		// The capture needs a slot that the output already released
+		if( stage == Stage::CAPTURE ){
+			if( closed )
+				return NULL;
+			if( done[Stage::CAPTURE] - done[Stage::OUTPUT] < (int64) slots.size() )
+				break;
+		}
+		// The others need a slot that the previous stage already committed
+		else{
+			if( done[stage] < done[stage-1] )
+				break;
+			if( closed && done[stage-1] == done[Stage::CAPTURE] )
+				return NULL;
+		}
+
+		changed.wait( guard );
+	}
+
+	return &slots[ done[stage] % slots.size() ];
+}
+
+/** @fn void FrameRing::commit ( Stage::FrameStage stage )
+  *
+  * @brief	Gives the slot acquired by `stage` to the next stage.
+  */
+void FrameRing::commit ( Stage::FrameStage stage ){
+	{
+		lock_guard<mutex> guard ( lock );
+		done[stage]++;
+	}
+	changed.notify_all();
+}
+
+/** @fn void FrameRing::close ()
+  *
+  * @brief	The capture has no more frames. The other stages still
+  *		get everything already committed.
+  */
+void FrameRing::close (){
+	{
+		lock_guard<mutex> guard ( lock );
+		closed = true;
+	}
+	changed.notify_all();
+}
+
+/** @fn void FrameRing::abort ()
+  *
+  * @brief	Stops every stage now, dropping the frames in the ring.
+  */
+void FrameRing::abort (){
+	{
+		lock_guard<mutex> guard ( lock );
+		closed = aborted = true;
+	}
+	changed.notify_all();
+}
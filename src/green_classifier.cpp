@@ -0,0 +1,768 @@
+/** @file green_classifier.cpp
+  * @brief lookup-table classifier that maps a BGR pixel straight to the "best" green mask.
+  */
+//--INCLUDES--------------------------------------------------
+#include <HYP.hpp>
+#include <green_classifier.hpp>
+
+#include <fstream>
+#include <sstream>
+
+#if GREEN_SIMD
+#include <immintrin.h>
+#endif
+
+//--MACROS----------------------------------------------------
+// The fixed point HSV conversion of OpenCV for 8 bits images
+#define HSV_SHIFT		12
+#define HSV_SDIV_NUMERATOR	(255.f * (1 << HSV_SHIFT))
+#define HSV_HDIV_NUMERATOR	(180.f * (1 << HSV_SHIFT) / 6.f)
+// The bits of the Y of one U and V, in the table of NV12
+#define YUV_ROW_BYTES		(256 / 8)
+// The range of one U and V with no green Y: from 1 to 0
+#define YUV_RANGE_EMPTY		0x0001
+// The green Y of one U and V are not one run: look them up in the table
+#define YUV_IRREGULAR		0x10000
+///////////////////////////////////
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+//--GREEN_INTENSITY-------------------------------------------
+
+/** @fn uchar green_intensity ( uchar h, uchar s, uchar v, const GreenThresholds& t )
+  *
+  * @brief	The green test for one HSV pixel. This is the reference
+  *		that the table of GreenClassifier is built from.
+  *
+  * @return	255 if the pixel is the "best" green, 0 otherwise.
+  */
+uchar green_intensity ( uchar h, uchar s, uchar v, const GreenThresholds& t ){
+	int green_intensity; // Holds the green intensity!
+
+	/*	Test the green color.
+	 *
+	 *	If the green intensity were less than t.min_sat or
+	 *	distance from the green on Hue channel were greater
+	 *	than t.max_distance or the brightness were not at least
+	 *	t.min_bright: forget about this green. Set zero for this one.
+	 *
+	 *	If the green pass to the above test, so the color for
+	 *	this is 255 less the distance of t.hue. Pass the
+	 *	result value for the t.threshold.
+	 */
+	if( s <= t.min_sat )
+		green_intensity = 0;
+	else if ( v <= t.min_bright )
+		green_intensity = 0;
+	else if ( h < t.hue - t.max_distance ||
+		  h > t.hue + t.max_distance )
+		green_intensity = 0;
+	else{
+		green_intensity = 255 - (h - t.hue);
+		green_intensity = (green_intensity > t.threshold)?255:0;
+	}
+
+	return green_intensity;
+}
+
+//--NV12----------------------------------------------------
+
+/** @fn static inline uint64_t nv12_green ( const uint32_t* range, const uchar* table, unsigned int uv, uchar y )
+  *
+  * @brief	Whether the pixel of luma `y` and the chroma pair `uv`, U in
+  *		the low byte and V in the high one, is green: 1 or 0.
+  */
+static inline uint64_t nv12_green ( const uint32_t* range, const uchar* table, unsigned int uv, uchar y ){
+	const uint32_t r = range[uv];
+	if( r & YUV_IRREGULAR ){
+		const unsigned int i = (uv << 8) | y;
+		return ( table[i >> 3] >> (i & 7) ) & 1;
+	}
+	return y >= ( r & 0xFF ) && y <= ( ( r >> 8 ) & 0xFF );
+}
+
+//--VECTOR_KERNELS-------------------------------------------
+#if GREEN_SIMD
+
+/*	The thresholds of a preset, as constants. The kernels take them
+ *	or a GreenThresholds the same way, as `t.min_sat` and so on, so
+ *	each preset gets kernels with its thresholds as immediates.
+ */
+template <int MIN_SAT, int HUE, int MAX_DISTANCE, int MIN_BRIGHT, int THRESHOLD>
+struct FixedThresholds {
+	static const int min_sat = MIN_SAT;
+	static const int hue = HUE;
+	static const int max_distance = MAX_DISTANCE;
+	static const int min_bright = MIN_BRIGHT;
+	static const int threshold = THRESHOLD;
+};
+
+/*	The vector kernels do, in registers, the same fixed point HSV
+ *	conversion that cvtColor does for 8 bits images:
+ *
+ *		v    = max(b, g, r)
+ *		diff = v - min(b, g, r)
+ *		s    = (diff * sdiv[v] + 2^11) >> 12
+ *		h    = (hnum * hdiv[diff] + 2^11) >> 12, plus 180 if negative
+ *
+ *	where hnum depends on which channel is the max. The division tables
+ *	are round(255*2^12/v) and round(180*2^12/(6*diff)); a float division
+ *	rounded to the nearest integer gives exactly the same values. Then
+ *	the green test of green_intensity() is done with compares and the
+ *	branches become blends.
+ */
+
+/** @fn static __m128i green_test_sse41 ( __m128i b, __m128i g, __m128i r, const T& t )
+  *
+  * @brief	The green test for 4 pixels, one per 32 bits lane.
+  *
+  * @return	All bits set in the lanes of the green pixels.
+  */
+template <typename T>
+__attribute__((target("sse4.1")))
+static inline __m128i green_test_sse41 ( __m128i b, __m128i g, __m128i r, const T& t ){
+	const __m128i round = _mm_set1_epi32( 1 << (HSV_SHIFT-1) );
+
+	__m128i v    = _mm_max_epi32( b, _mm_max_epi32( g, r ) );
+	__m128i diff = _mm_sub_epi32( v, _mm_min_epi32( b, _mm_min_epi32( g, r ) ) );
+
+	// Saturation
+	__m128i sdiv = _mm_cvtps_epi32( _mm_div_ps( _mm_set1_ps( HSV_SDIV_NUMERATOR ), _mm_cvtepi32_ps( v ) ) );
+	__m128i s    = _mm_srai_epi32( _mm_add_epi32( _mm_mullo_epi32( diff, sdiv ), round ), HSV_SHIFT );
+
+	// Hue
+	__m128i diff2 = _mm_add_epi32( diff, diff );
+	__m128i h_r   = _mm_sub_epi32( g, b );
+	__m128i h_g   = _mm_add_epi32( _mm_sub_epi32( b, r ), diff2 );
+	__m128i h_b   = _mm_add_epi32( _mm_sub_epi32( r, g ), _mm_add_epi32( diff2, diff2 ) );
+	__m128i hnum  = _mm_blendv_epi8( h_b, h_g, _mm_cmpeq_epi32( v, g ) );
+	hnum = _mm_blendv_epi8( hnum, h_r, _mm_cmpeq_epi32( v, r ) );
+
+	__m128i hdiv = _mm_cvtps_epi32( _mm_div_ps( _mm_set1_ps( HSV_HDIV_NUMERATOR ), _mm_cvtepi32_ps( diff ) ) );
+	__m128i h    = _mm_srai_epi32( _mm_add_epi32( _mm_mullo_epi32( hnum, hdiv ), round ), HSV_SHIFT );
+	h = _mm_add_epi32( h, _mm_and_si128( _mm_cmplt_epi32( h, _mm_setzero_si128() ), _mm_set1_epi32( 180 ) ) );
+
+	// The green test
+	__m128i green = _mm_and_si128(
+				_mm_cmpgt_epi32( s, _mm_set1_epi32( t.min_sat ) ),
+				_mm_cmpgt_epi32( v, _mm_set1_epi32( t.min_bright ) ) );
+	green = _mm_andnot_si128( _mm_cmplt_epi32( h, _mm_set1_epi32( t.hue - t.max_distance ) ), green );
+	green = _mm_andnot_si128( _mm_cmpgt_epi32( h, _mm_set1_epi32( t.hue + t.max_distance ) ), green );
+	green = _mm_and_si128( green, _mm_cmpgt_epi32(
+					_mm_sub_epi32( _mm_set1_epi32( 255 + t.hue ), h ),
+					_mm_set1_epi32( t.threshold ) ) );
+	return green;
+}
+
+/** @fn static void deinterleave_bgr ( const uchar* src, __m128i& b, __m128i& g, __m128i& r )
+  *
+  * @brief	Splits 16 BGR pixels (48 bytes) in the three channels.
+  */
+__attribute__((target("sse4.1")))
+static inline void deinterleave_bgr ( const uchar* src, __m128i& b, __m128i& g, __m128i& r ){
+	const __m128i c0 = _mm_loadu_si128( (const __m128i*) src );
+	const __m128i c1 = _mm_loadu_si128( (const __m128i*) (src + 16) );
+	const __m128i c2 = _mm_loadu_si128( (const __m128i*) (src + 32) );
+
+	b = _mm_or_si128( _mm_or_si128(
+		_mm_shuffle_epi8( c0, _mm_setr_epi8( 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1) ),
+		_mm_shuffle_epi8( c1, _mm_setr_epi8(-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14,-1,-1,-1,-1,-1) ) ),
+		_mm_shuffle_epi8( c2, _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 1, 4, 7,10,13) ) );
+	g = _mm_or_si128( _mm_or_si128(
+		_mm_shuffle_epi8( c0, _mm_setr_epi8( 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1) ),
+		_mm_shuffle_epi8( c1, _mm_setr_epi8(-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1) ) ),
+		_mm_shuffle_epi8( c2, _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14) ) );
+	r = _mm_or_si128( _mm_or_si128(
+		_mm_shuffle_epi8( c0, _mm_setr_epi8( 2, 5, 8,11,14,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1) ),
+		_mm_shuffle_epi8( c1, _mm_setr_epi8(-1,-1,-1,-1,-1, 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1) ) ),
+		_mm_shuffle_epi8( c2, _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15) ) );
+}
+
+/** @fn static int green_classify_sse41 ( const uchar* src, uchar* dst, int n, const T& t )
+  *
+  * @brief	Classifies 16 BGR pixels at a time.
+  *
+  * @return	How many pixels were classified, a multiple of 16.
+  */
+template <typename T>
+__attribute__((target("sse4.1")))
+static int green_classify_sse41 ( const uchar* src, uchar* dst, int n, const T& t ){
+	int j = 0;
+
+	for ( ; j + 16 <= n; j += 16, src += 48, dst += 16 ){
+		__m128i b, g, r;
+		deinterleave_bgr ( src, b, g, r );
+
+		// 4 pixels per test, widened to 32 bits
+		__m128i m0 = green_test_sse41( _mm_cvtepu8_epi32( b ),
+						_mm_cvtepu8_epi32( g ),
+						_mm_cvtepu8_epi32( r ), t );
+		__m128i m1 = green_test_sse41( _mm_cvtepu8_epi32( _mm_srli_si128( b, 4 ) ),
+						_mm_cvtepu8_epi32( _mm_srli_si128( g, 4 ) ),
+						_mm_cvtepu8_epi32( _mm_srli_si128( r, 4 ) ), t );
+		__m128i m2 = green_test_sse41( _mm_cvtepu8_epi32( _mm_srli_si128( b, 8 ) ),
+						_mm_cvtepu8_epi32( _mm_srli_si128( g, 8 ) ),
+						_mm_cvtepu8_epi32( _mm_srli_si128( r, 8 ) ), t );
+		__m128i m3 = green_test_sse41( _mm_cvtepu8_epi32( _mm_srli_si128( b, 12 ) ),
+						_mm_cvtepu8_epi32( _mm_srli_si128( g, 12 ) ),
+						_mm_cvtepu8_epi32( _mm_srli_si128( r, 12 ) ), t );
+
+		// All bits set become 255, the rest 0
+		__m128i mask = _mm_packs_epi16( _mm_packs_epi32( m0, m1 ), _mm_packs_epi32( m2, m3 ) );
+		_mm_storeu_si128( (__m128i*) dst, mask );
+	}
+
+	return j;
+}
+
+/** @fn static __m256i green_test_avx2 ( __m256i b, __m256i g, __m256i r, const T& t )
+  *
+  * @brief	The green test for 8 pixels, same as green_test_sse41().
+  */
+template <typename T>
+__attribute__((target("avx2")))
+static inline __m256i green_test_avx2 ( __m256i b, __m256i g, __m256i r, const T& t ){
+	const __m256i round = _mm256_set1_epi32( 1 << (HSV_SHIFT-1) );
+
+	__m256i v    = _mm256_max_epi32( b, _mm256_max_epi32( g, r ) );
+	__m256i diff = _mm256_sub_epi32( v, _mm256_min_epi32( b, _mm256_min_epi32( g, r ) ) );
+
+	// Saturation
+	__m256i sdiv = _mm256_cvtps_epi32( _mm256_div_ps( _mm256_set1_ps( HSV_SDIV_NUMERATOR ), _mm256_cvtepi32_ps( v ) ) );
+	__m256i s    = _mm256_srai_epi32( _mm256_add_epi32( _mm256_mullo_epi32( diff, sdiv ), round ), HSV_SHIFT );
+
+	// Hue
+	__m256i diff2 = _mm256_add_epi32( diff, diff );
+	__m256i h_r   = _mm256_sub_epi32( g, b );
+	__m256i h_g   = _mm256_add_epi32( _mm256_sub_epi32( b, r ), diff2 );
+	__m256i h_b   = _mm256_add_epi32( _mm256_sub_epi32( r, g ), _mm256_add_epi32( diff2, diff2 ) );
+	__m256i hnum  = _mm256_blendv_epi8( h_b, h_g, _mm256_cmpeq_epi32( v, g ) );
+	hnum = _mm256_blendv_epi8( hnum, h_r, _mm256_cmpeq_epi32( v, r ) );
+
+	__m256i hdiv = _mm256_cvtps_epi32( _mm256_div_ps( _mm256_set1_ps( HSV_HDIV_NUMERATOR ), _mm256_cvtepi32_ps( diff ) ) );
+	__m256i h    = _mm256_srai_epi32( _mm256_add_epi32( _mm256_mullo_epi32( hnum, hdiv ), round ), HSV_SHIFT );
+	h = _mm256_add_epi32( h, _mm256_and_si256( _mm256_cmpgt_epi32( _mm256_setzero_si256(), h ), _mm256_set1_epi32( 180 ) ) );
+
+	// The green test
+	__m256i green = _mm256_and_si256(
+				_mm256_cmpgt_epi32( s, _mm256_set1_epi32( t.min_sat ) ),
+				_mm256_cmpgt_epi32( v, _mm256_set1_epi32( t.min_bright ) ) );
+	green = _mm256_andnot_si256( _mm256_cmpgt_epi32( _mm256_set1_epi32( t.hue - t.max_distance ), h ), green );
+	green = _mm256_andnot_si256( _mm256_cmpgt_epi32( h, _mm256_set1_epi32( t.hue + t.max_distance ) ), green );
+	green = _mm256_and_si256( green, _mm256_cmpgt_epi32(
+					_mm256_sub_epi32( _mm256_set1_epi32( 255 + t.hue ), h ),
+					_mm256_set1_epi32( t.threshold ) ) );
+	return green;
+}
+
+/** @fn static int green_classify_avx2 ( const uchar* src, uchar* dst, int n, const T& t )
+  *
+  * @brief	Classifies 32 BGR pixels at a time.
+  *
+  * @return	How many pixels were classified, a multiple of 32.
+  */
+template <typename T>
+__attribute__((target("avx2")))
+static int green_classify_avx2 ( const uchar* src, uchar* dst, int n, const T& t ){
+	int j = 0;
+
+	for ( ; j + 32 <= n; j += 32, src += 96, dst += 32 ){
+		__m128i b0, g0, r0, b1, g1, r1;
+		deinterleave_bgr ( src,      b0, g0, r0 );
+		deinterleave_bgr ( src + 48, b1, g1, r1 );
+
+		// 8 pixels per test, widened to 32 bits
+		__m256i m0 = green_test_avx2( _mm256_cvtepu8_epi32( b0 ),
+						_mm256_cvtepu8_epi32( g0 ),
+						_mm256_cvtepu8_epi32( r0 ), t );
+		__m256i m1 = green_test_avx2( _mm256_cvtepu8_epi32( _mm_srli_si128( b0, 8 ) ),
+						_mm256_cvtepu8_epi32( _mm_srli_si128( g0, 8 ) ),
+						_mm256_cvtepu8_epi32( _mm_srli_si128( r0, 8 ) ), t );
+		__m256i m2 = green_test_avx2( _mm256_cvtepu8_epi32( b1 ),
+						_mm256_cvtepu8_epi32( g1 ),
+						_mm256_cvtepu8_epi32( r1 ), t );
+		__m256i m3 = green_test_avx2( _mm256_cvtepu8_epi32( _mm_srli_si128( b1, 8 ) ),
+						_mm256_cvtepu8_epi32( _mm_srli_si128( g1, 8 ) ),
+						_mm256_cvtepu8_epi32( _mm_srli_si128( r1, 8 ) ), t );
+
+		// The packs work inside each 128 bits lane, so put the quads back in order
+		__m256i m01  = _mm256_permute4x64_epi64( _mm256_packs_epi32( m0, m1 ), 0xD8 );
+		__m256i m23  = _mm256_permute4x64_epi64( _mm256_packs_epi32( m2, m3 ), 0xD8 );
+		__m256i mask = _mm256_permute4x64_epi64( _mm256_packs_epi16( m01, m23 ), 0xD8 );
+		_mm256_storeu_si256( (__m256i*) dst, mask );
+	}
+
+	return j;
+}
+
+//! The kernels of a preset, with the thresholds of T and not the ones given.
+template <typename T>
+static int preset_sse41 ( const uchar* src, uchar* dst, int n, const GreenThresholds& ){
+	return green_classify_sse41 ( src, dst, n, T() );
+}
+
+template <typename T>
+static int preset_avx2 ( const uchar* src, uchar* dst, int n, const GreenThresholds& ){
+	return green_classify_avx2 ( src, dst, n, T() );
+}
+
+//! The generic kernels, for any thresholds.
+static int generic_sse41 ( const uchar* src, uchar* dst, int n, const GreenThresholds& t ){
+	return green_classify_sse41 ( src, dst, n, t );
+}
+
+static int generic_avx2 ( const uchar* src, uchar* dst, int n, const GreenThresholds& t ){
+	return green_classify_avx2 ( src, dst, n, t );
+}
+
+/** @fn static int nv12_rows_avx2 ( const uchar* luma[2], const uchar* chroma, int n, const uint32_t* range, const uchar* table, uint64_t* dst[2] )
+  *
+  * @brief	Two rows of an NV12 frame, that share `chroma`, straight to
+  *		the words of their masks, 64 pixels at a time.
+  *
+  * The ranges of 16 chroma pairs are gathered at once and spread to
+  * the 32 pixels under them, then the luma of both rows is compared
+  * with them. The pairs with no single range are looked up one by one.
+  *
+  * @return	How many pixels were classified, a multiple of 64.
+  */
+__attribute__((target("avx2")))
+static int nv12_rows_avx2 ( const uchar* luma[2], const uchar* chroma, int n, const uint32_t* range,
+			    const uchar* table, uint64_t* dst[2] ){
+	// In every 128 bits lane, the low bytes of 4 ranges twice each, then the high ones
+	const __m256i spread = _mm256_setr_epi8(
+		0, 0, 4, 4, 8, 8, 12, 12, 1, 1, 5, 5, 9, 9, 13, 13,
+		0, 0, 4, 4, 8, 8, 12, 12, 1, 1, 5, 5, 9, 9, 13, 13 );
+	int x = 0;
+
+	for ( ; x + 64 <= n; x += 64 ){
+		uint64_t w[2] = { 0, 0 };
+
+		for ( int k = 0; k < 64; k += 32 ){
+			const int c = x + k;
+
+			// The 16 chroma pairs as indices, U in the low byte
+			__m256i uv = _mm256_loadu_si256( (const __m256i*) ( chroma + c ) );
+			__m256i g0 = _mm256_i32gather_epi32( (const int*) range, _mm256_cvtepu16_epi32( _mm256_castsi256_si128( uv ) ), 4 );
+			__m256i g1 = _mm256_i32gather_epi32( (const int*) range, _mm256_cvtepu16_epi32( _mm256_extracti128_si256( uv, 1 ) ), 4 );
+
+			// The lowest and highest green Y of every pixel, in pixel order
+			__m256i s0 = _mm256_shuffle_epi8( g0, spread );
+			__m256i s1 = _mm256_shuffle_epi8( g1, spread );
+			__m256i lo = _mm256_permute4x64_epi64( _mm256_unpacklo_epi64( s0, s1 ), 0xD8 );
+			__m256i hi = _mm256_permute4x64_epi64( _mm256_unpackhi_epi64( s0, s1 ), 0xD8 );
+
+			for ( int r = 0; r < 2; r++ ){
+				__m256i y = _mm256_loadu_si256( (const __m256i*) ( luma[r] + c ) );
+				__m256i in = _mm256_and_si256( _mm256_cmpeq_epi8( _mm256_max_epu8( y, lo ), y ),
+							       _mm256_cmpeq_epi8( _mm256_min_epu8( y, hi ), y ) );
+				w[r] |= (uint64_t) (uint32_t) _mm256_movemask_epi8( in ) << k;
+			}
+
+			// YUV_IRREGULAR moved to the sign bit, one bit per pair
+			unsigned int irregular =
+				_mm256_movemask_ps( _mm256_castsi256_ps( _mm256_slli_epi32( g0, 15 ) ) ) |
+				_mm256_movemask_ps( _mm256_castsi256_ps( _mm256_slli_epi32( g1, 15 ) ) ) << 8;
+
+			for ( ; irregular; irregular &= irregular - 1 ){
+				const int p = 2 * __builtin_ctz( irregular );
+				const unsigned int pair = chroma[c + p] | ( chroma[c + p + 1] << 8 );
+				for ( int r = 0; r < 2; r++ ){
+					w[r] |= nv12_green( range, table, pair, luma[r][c + p] ) << (k + p);
+					w[r] |= nv12_green( range, table, pair, luma[r][c + p + 1] ) << (k + p + 1);
+				}
+			}
+		}
+
+		*dst[0]++ = w[0];
+		*dst[1]++ = w[1];
+	}
+
+	return x;
+}
+
+#define GREEN_PRESET(name, min_sat, hue, max_distance, min_bright, threshold) \
+	{ name, GreenThresholds( min_sat, hue, max_distance, min_bright, threshold ), \
+	  preset_sse41< FixedThresholds<min_sat, hue, max_distance, min_bright, threshold> >, \
+	  preset_avx2< FixedThresholds<min_sat, hue, max_distance, min_bright, threshold> > }
+
+#else
+
+#define GREEN_PRESET(name, min_sat, hue, max_distance, min_bright, threshold) \
+	{ name, GreenThresholds( min_sat, hue, max_distance, min_bright, threshold ), NULL, NULL }
+
+#endif //GREEN_SIMD
+
+//--PRESETS---------------------------------------------------
+
+/*	The greens with kernels of their own. Any other thresholds work
+ *	too, with the generic kernels; a green used for good goes here.
+ */
+static const GreenClassifier::Preset presets[] = {
+	// The thresholds this was tuned with
+	GREEN_PRESET( "default",	BGREEN_MIN_SAT, BGREEN_HUE, BGREEN_MAX_DISTANCE, BGREEN_MIN_BRIGHT, BGREEN_THRESHOLD ),
+	// The first hue distance: less of the skin and of the yellow lights
+	GREEN_PRESET( "narrow",		60, 60, 15, 25, 200 ),
+	// Dark rooms, where the cards are not bright
+	GREEN_PRESET( "dim",		60, 60, 25, 10, 200 )
+};
+
+/** @fn bool green_preset ( const string& name, GreenThresholds& t )
+  *
+  * @brief	The thresholds of the preset `name`, in `t`.
+  *
+  * @return	false, and `t` untouched, if there is no such preset.
+  */
+bool green_preset ( const string& name, GreenThresholds& t ){
+	for ( size_t i = 0; i < sizeof(presets)/sizeof(*presets); i++ ){
+		if( name == presets[i].name ){
+			t = presets[i].thresholds;
+			return true;
+		}
+	}
+	return false;
+}
+
+/** @fn bool load_green_thresholds ( const string& path, GreenThresholds& t )
+  *
+  * @brief	Reads the thresholds from a text file, a `key value` per
+  *		line, where the keys are `preset` (a name) and the
+  *		fields of GreenThresholds. They apply in order, so a
+  *		preset can be changed by the lines after it. Blank lines
+  *		and the ones starting with '#' are skipped.
+  *
+  * @return	false, with the line on cerr, if a line is not understood.
+  */
+bool load_green_thresholds ( const string& path, GreenThresholds& t ){
+	ifstream in ( path.c_str() );
+	if( !in ){
+		cerr << path << ": cannot open" << endl;
+		return false;
+	}
+
+	string line;
+	for ( int n = 1; getline( in, line ); n++ ){
+		istringstream words ( line );
+		string key, value;
+		if( !( words >> key ) || key[0] == '#' )
+			continue;
+
+		bool ok = bool( words >> value );
+		if( ok && key == "preset" )
+			ok = green_preset( value, t );
+		else if( ok ){
+			int* field =	key == "min_sat"	? &t.min_sat :
+					key == "hue"		? &t.hue :
+					key == "max_distance"	? &t.max_distance :
+					key == "min_bright"	? &t.min_bright :
+					key == "threshold"	? &t.threshold : NULL;
+			char* end;
+			long v = strtol( value.c_str(), &end, 10 );
+			ok = field && !*end && v >= 0 && v <= 255;
+			if( ok )
+				*field = (int) v;
+		}
+
+		if( !ok ){
+			cerr << path << ":" << n << ": not understood: " << line << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//--GREEN_CLASSIFIER------------------------------------------
+
+/** @fn GreenClassifier::GreenClassifier ( const GreenThresholds& thresholds, GreenKernel fastest, bool specialized )
+  *
+  * @brief	Builds the table. Every color goes through the same
+  *		HSV conversion that best_green used to do per frame,
+  *		one plane of 256x256 colors (fixed blue) at a time.
+  *
+  * @param specialized	Use the kernels of the preset with these
+  *			thresholds, if there is one, and not the generic ones.
+  */
+GreenClassifier::GreenClassifier ( const GreenThresholds& thresholds, GreenKernel fastest, bool specialized ) :
+	table ( GREEN_TABLE_SIZE/8, 0 ), thresholds ( thresholds ), preset ( NULL ), kernel ( GREEN_KERNEL_TABLE ){
+
+	for ( size_t i = 0; specialized && !preset && i < sizeof(presets)/sizeof(*presets); i++ )
+		if( presets[i].thresholds == thresholds )
+			preset = &presets[i];
+
+	Mat plane ( 256, 256, CV_8UC3 );	// all colors with the same blue
+	Mat plane_hsv;				// and them in the HSV color space
+
+	for ( int b = 0; b < 256; b++ ){
+
+		// Row is the green, column is the red
+		for ( int g = 0; g < 256; g++ ){
+			uchar* ptr = plane.ptr<uchar>(g);
+			for ( int r = 0; r < 256; r++ ){
+				ptr[Color::B] = b;
+				ptr[Color::G] = g;
+				ptr[Color::R] = r;
+				ptr += plane.channels();
+			}
+		}
+
+		cvtColor( plane, plane_hsv, CV_BGR2HSV );
+
+		for ( int g = 0; g < 256; g++ ){
+			const uchar* ptr = plane_hsv.ptr<uchar>(g);
+			for ( int r = 0; r < 256; r++ ){
+				if( green_intensity( ptr[Color::H], ptr[Color::S], ptr[Color::V], thresholds ) ){
+					const unsigned int i = (b << 16) | (g << 8) | r;
+					table[i >> 3] |= 1 << (i & 7);
+				}
+				ptr += plane_hsv.channels();
+			}
+		}
+	}
+
+	// Pick the fastest vector kernel that the CPU has and that agrees with the table
+	#if GREEN_SIMD
+	__builtin_cpu_init();
+
+	if( fastest >= GREEN_KERNEL_AVX2 && __builtin_cpu_supports("avx2") &&
+	    agrees_with_table( GREEN_KERNEL_AVX2 ) )
+		kernel = GREEN_KERNEL_AVX2;
+	else if( fastest >= GREEN_KERNEL_SSE41 && __builtin_cpu_supports("sse4.1") &&
+		 agrees_with_table( GREEN_KERNEL_SSE41 ) )
+		kernel = GREEN_KERNEL_SSE41;
+	#else
+	(void) fastest;
+	#endif
+
+	DEBUG("green kernel: " << kernel << ( preset ? " for the preset " : " generic" ) << ( preset ? preset->name : "" ), 1);
+}
+
+/** @fn bool GreenClassifier::agrees_with_table ( GreenKernel k ) const
+  *
+  * @brief	Classifies every BGR color with the kernel `k` and
+  *		compares, bit for bit, with the table.
+  */
+bool GreenClassifier::agrees_with_table ( GreenKernel k ) const {
+	Mat plane ( 1, 256*256, CV_8UC3 );	// all colors with the same blue
+	Mat plane_mask ( 1, 256*256, CV_8UC1 );
+
+	for ( int b = 0; b < 256; b++ ){
+		uchar* ptr = plane.ptr<uchar>(0);
+		for ( int g = 0; g < 256; g++ ){
+			for ( int r = 0; r < 256; r++ ){
+				ptr[Color::B] = b;
+				ptr[Color::G] = g;
+				ptr[Color::R] = r;
+				ptr += plane.channels();
+			}
+		}
+
+		classify_row ( k, plane.ptr<uchar>(0), plane_mask.ptr<uchar>(0), plane.cols );
+
+		const uchar* ptr_mask = plane_mask.ptr<uchar>(0);
+		for ( int i = 0; i < plane.cols; i++ ){
+			if( ptr_mask[i] != ( is_green( b, i >> 8, i & 0xFF ) ? 255 : 0 ) ){
+				DEBUG("green kernel " << k << " disagrees with the table", 1);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/** @fn void GreenClassifier::classify_row ( GreenKernel k, const uchar* src, uchar* dst, int n ) const
+  *
+  * @brief	Classifies `n` BGR pixels with the kernel `k`. What is
+  *		left after the vector kernel goes through the table.
+  */
+void GreenClassifier::classify_row ( GreenKernel k, const uchar* src, uchar* dst, int n ) const {
+	int j = 0;
+
+	#if GREEN_SIMD
+	if( k == GREEN_KERNEL_AVX2 )
+		j = preset ? preset->avx2 ( src, dst, n, thresholds ) : generic_avx2 ( src, dst, n, thresholds );
+	else if( k == GREEN_KERNEL_SSE41 )
+		j = preset ? preset->sse41 ( src, dst, n, thresholds ) : generic_sse41 ( src, dst, n, thresholds );
+	#else
+	(void) k;
+	#endif
+
+	for ( src += j*3, dst += j; j<n; j++ ){
+		*dst = is_green( src[Color::B], src[Color::G], src[Color::R] ) ? 255 : 0;
+
+		src += 3;
+		dst++;
+	}
+}
+
+/** @fn void GreenClassifier::classify ( const Mat& frame, Mat& mask ) const
+  *
+  * @param frame	BGR input frame.
+  * @param mask		One channel output, 255 where the frame is green and
+  *			0 elsewhere. Must have the frame size.
+  */
+void GreenClassifier::classify ( const Mat& frame, Mat& mask ) const {
+	for ( int i = 0; i<frame.rows; i++ )
+		classify_row ( kernel, frame.ptr<uchar>(i), mask.ptr<uchar>(i), frame.cols );
+}
+
+//! The same, one bit per pixel, in `bits` that gets the frame size.
+void GreenClassifier::classify ( const Mat& frame, BitMask& bits ) const {
+	bits.create( frame.size() );
+	classify ( frame, bits, Point(0, 0) );
+}
+
+/** @fn void GreenClassifier::classify ( const Mat& frame, BitMask& bits, Point at ) const
+  *
+  * @brief	The same, in the pixels of `bits` from `at` on, for a part of
+  *		a bigger frame. `at.x` must be the first pixel of a word, and
+  *		the words of the last pixels are written whole.
+  */
+void GreenClassifier::classify ( const Mat& frame, BitMask& bits, Point at ) const {
+	CV_Assert( at.x % BIT_MASK_WORD == 0 );
+
+	// A row in bytes, as the kernels write it, right before it is packed
+	static thread_local vector<uchar> row;
+	if( row.size() < (size_t) frame.cols )
+		row.resize( frame.cols );
+
+	for ( int i = 0; i<frame.rows; i++ ){
+		classify_row ( kernel, frame.ptr<uchar>(i), &row[0], frame.cols );
+		pack_row ( &row[0], bits.row( at.y + i ) + at.x / BIT_MASK_WORD, frame.cols );
+	}
+}
+
+//! The thresholds of get(), the "default" preset if not configured.
+static GreenThresholds configured;
+
+/** @fn void GreenClassifier::build_yuv_table () const
+  *
+  * @brief	Every YUV color goes through the NV12 conversion of OpenCV
+  *		and the table of BGR, one V at a time: a 512x128 NV12
+  *		image with a 2x2 block for every U and 4 values of Y.
+  *
+  * The bits of a chroma pair are the 256 of its Y side by side. For
+  * almost every pair the green Y are one run, or none, so yuv_range
+  * keeps its first and last Y, and only the others are YUV_IRREGULAR.
+  */
+void GreenClassifier::build_yuv_table () const {
+	yuv_table.assign( GREEN_TABLE_SIZE/8, 0 );
+
+	Mat nv12 ( 128 + 64, 512, CV_8UC1 );	// the Y plane, then U and V side by side
+	Mat bgr;
+
+	// Y is 4 times the block row plus the place in the block
+	for ( int y = 0; y < 128; y++ ){
+		uchar* ptr = nv12.ptr<uchar>(y);
+		for ( int x = 0; x < 512; x++ )
+			ptr[x] = 4*(y/2) + 2*(y%2) + x%2;
+	}
+
+	for ( int v = 0; v < 256; v++ ){
+		for ( int y = 128; y < nv12.rows; y++ ){
+			uchar* ptr = nv12.ptr<uchar>(y);
+			for ( int u = 0; u < 256; u++ ){
+				ptr[2*u] = u;
+				ptr[2*u + 1] = v;
+			}
+		}
+
+		cvtColor( nv12, bgr, CV_YUV2BGR_NV12 );
+
+		for ( int y = 0; y < bgr.rows; y++ ){
+			const uchar* luma = nv12.ptr<uchar>(y);
+			const uchar* ptr = bgr.ptr<uchar>(y);
+			for ( int x = 0; x < bgr.cols; x++, ptr += 3 ){
+				if( is_green( ptr[Color::B], ptr[Color::G], ptr[Color::R] ) ){
+					const unsigned int i = (v << 16) | ((x/2) << 8) | luma[x];
+					yuv_table[i >> 3] |= 1 << (i & 7);
+				}
+			}
+		}
+	}
+
+	yuv_range.assign( 256*256, YUV_RANGE_EMPTY );
+	for ( size_t uv = 0; uv < yuv_range.size(); uv++ ){
+		const uchar* bits = &yuv_table[uv * YUV_ROW_BYTES];
+		int first = -1, last = -1, n = 0;
+
+		for ( int y = 0; y < 256; y++ )
+			if( ( bits[y >> 3] >> (y & 7) ) & 1 ){
+				if( first < 0 )
+					first = y;
+				last = y;
+				n++;
+			}
+
+		if( n && n == last - first + 1 )
+			yuv_range[uv] = first | (last << 8);
+		else if( n )
+			yuv_range[uv] = YUV_RANGE_EMPTY | YUV_IRREGULAR;
+	}
+}
+
+/** @fn void GreenClassifier::classify_nv12 ( const Mat& nv12, BitMask& bits ) const
+  *
+  * @brief	The mask of an NV12 frame, with no conversion to BGR.
+  *
+  * Two rows at a time, as they share the row of U and V: every pixel
+  * is green if its Y is in the range of its chroma pair. With AVX2, 32
+  * pixels of both rows at a time; what is left, one pair at a time.
+  *
+  * @param nv12		One channel, the rows of Y and then half as many
+  *			of U and V interleaved, one pair for every 2x2
+  *			pixels: an image 3/2 as tall as the frame.
+  * @param bits		Gets the size of the frame.
+  */
+void GreenClassifier::classify_nv12 ( const Mat& nv12, BitMask& bits ) const {
+	call_once( yuv_built, &GreenClassifier::build_yuv_table, this );
+
+	const int rows = nv12.rows * 2 / 3;
+	const uint32_t* range = &yuv_range[0];
+	const uchar* table = &yuv_table[0];
+	bits.create( Size( nv12.cols, rows ) );
+
+	for ( int i = 0; i<rows; i += 2 ){
+		const int below = min( i + 1, rows - 1 );	// the same row, if the last is alone
+		const uchar* luma[2] = { nv12.ptr<uchar>(i), nv12.ptr<uchar>(below) };
+		const uchar* chroma = nv12.ptr<uchar>(rows + i/2);
+		uint64_t* dst[2] = { bits.row( i ), bits.row( below ) };
+		int x = 0;
+
+		#if GREEN_SIMD
+		if( kernel == GREEN_KERNEL_AVX2 )
+			x = nv12_rows_avx2 ( luma, chroma, nv12.cols, range, table, dst );
+		#endif
+
+		// Straight to the bits, a word of each row at a time
+		for ( ; x<nv12.cols; x += BIT_MASK_WORD ){
+			const int m = min( nv12.cols - x, BIT_MASK_WORD );
+			uint64_t w[2] = { 0, 0 };
+
+			for ( int k = 0; k < m; k += 2 ){
+				const int c = x + k;
+				const unsigned int uv = chroma[c] | (chroma[c + 1] << 8);
+				for ( int r = 0; r < 2; r++ ){
+					w[r] |= nv12_green( range, table, uv, luma[r][c] ) << k;
+					if( k + 1 < m )
+						w[r] |= nv12_green( range, table, uv, luma[r][c + 1] ) << (k + 1);
+				}
+			}
+
+			*dst[0]++ = w[0];
+			*dst[1]++ = w[1];
+		}
+	}
+}
+
+const GreenClassifier& GreenClassifier::get (){
+	static const GreenClassifier classifier ( configured );
+	return classifier;
+}
+
+void GreenClassifier::configure ( const GreenThresholds& thresholds ){
+	configured = thresholds;
+}
@@ -3,12 +3,27 @@
   */
 
 #include <HYP.hpp>
+#include <green_classifier.hpp>
+#include <frame_ring.hpp>
+#include <thread_pool.hpp>
+#include <processor.hpp>
+#include <frame_history.hpp>
+#include <stage_timer.hpp>
+#include <raw_frames.hpp>
+#include <async_writer.hpp>
+
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <unistd.h> // getopt
 
 //--MACROS----------------------------------------------------
 #define WINDOW_TITLE		"Hold Your Past Input"
 #define WINDOW_TITLE_PROCESSED	"Hold Your Past"
 #define ESC_KEY 27
 #define DEFAULT_OUTPUT "_out"
+#define DEFAULT_FPS 30
+#define OUTPUT_FOURCC CV_FOURCC('M', 'J', 'P', 'G')
 
 // DEBUG MACROS
 #define DEBUG_SHOW_INPUT		0
@@ -24,70 +39,337 @@ using namespace cv;
   FLAGS AND CONSTRAITS
   ---------------------------------*/
 bool WRITE_CURRENT_FRAME = false;
+bool HEADLESS = false;	// no windows and no keys, just process as fast as possible
 string filename;
+string output;		// video file or image sequence (printf pattern, like out_%05d.png)
+size_t ring_depth = FRAME_RING_DEFAULT_DEPTH;
+size_t roi_workers = thread::hardware_concurrency() > 1 ? thread::hardware_concurrency() - 1 : 0;
+size_t past_delay = FRAME_HISTORY_DEFAULT_DELAY;	// the past shown is this many frames ago
+size_t history_budget = 0;	// bytes for the past frames, 0 for no limit
+string record_file;	// the frames as captured, in a container of raw frames
+size_t async_depth = 0;	// buffers of the writer of the output, 0 to write it in the output thread
+bool yuv_input = false;	// ask the decoder for NV12 and find the green in it
+ProcessorSettings settings;	// how the cards are searched, the same for every stream
+string stats_file;	// latency of every stage, CSV or JSON by the extension
+int stats_every = 0;	// frames between two writes of the stats, 0 for only at the end
+atomic<int> frames_out ( 0 );	// of all the streams, for the stats
+
+//! One source and everything its pipeline keeps from a frame to the next.
+struct Stream {
+	string source;		// video file, or camera number
+	string output;		// like the global one, for this stream
+	VideoCapture cap;
+	bool nv12;		// the capture gives the frames as decoded, NV12
+	RawReader raw;		// or the frames are replayed from a container
+	bool replay;
+	double fps;
 
-//pipeline
-void pipeline ( Mat& frame ){
-	static Mat last_frame = Mat(frame.size(), frame.type());
+	unique_ptr<FrameRing> ring;
+	unique_ptr<FrameHistory> history;	// the past frames, sharing the buffers of the ring
 
-	// Find the green
-	Mat green_blob = best_green ( frame );
+	unique_ptr<Processor> processor;
 
-	#if DEBUG_SHOW_GREEN_BLOB
-	imshow ( DEBUG_WINDOW_TITLE_GREEN_BLOB, green_blob );
-	#endif
-	
-
-	// Find ROIS
-	vector< Rect > roi;
-	find_connected_components ( green_blob, roi );
-	extend_and_group_bounding_rects ( roi, green_blob.size() ); 
-
-	// For every ROI
-	for ( size_t i=0; i<roi.size(); i++ ){
-		Mat frame_roi = Mat(frame, roi[i]);
-		Mat blob_roi  = Mat(green_blob, roi[i]);
-		Mat contours  = blob_roi.clone();
-
-		// Get good quadrilaterals
-		vector<Quadrilateral> quadrilateral;
-		get_good_quadrilaterals ( contours,  quadrilateral );
-
-		if( last_frame.data ){
-			// For every quadrilateral, replace the image
-			for ( size_t i=0; i<quadrilateral.size(); i++ )
-				replace_quadrilateral_by_image (
-					frame_roi, last_frame, blob_roi, quadrilateral[i] );
-		}
+	VideoWriter video;
+	RawWriter raw_output;	// when the output is a container
+	RawWriter record;	// the frames as captured
+	unique_ptr<AsyncWriter> writer;	// snapshots and, with -a, the output; stops before the above
+	int n_written;
+	int n_frames;		// out of the output
 
-		#if DEBUG_SHOW_CORNERS
-		draw_point( frame_roi, quadrilateral );
-		#endif
-		
+	Stream () : nv12 ( false ), replay ( false ), fps ( DEFAULT_FPS ), n_written ( 0 ), n_frames ( 0 ){
 	}
+};
+
+//! Runs the ROIs of every stream.
+ThreadPool& shared_pool (){
+	static ThreadPool pool ( roi_workers );
+	return pool;
+}
 
-	last_frame = frame.clone();
+//output
+void write_output( Stream& stream, const Mat& frame ){
+	if( stream.output.empty() )
+		return;
+
+	// An image sequence
+	if( stream.output.find('%') != string::npos ){
+		char name[FILENAME_MAX];
+		snprintf( name, sizeof(name), stream.output.c_str(), stream.n_written );
+		imwrite( name, frame );
+	}else if( is_raw_frames( stream.output ) )
+		stream.raw_output.write( frame );
+	else
+		stream.video.write( frame );
+
+	stream.n_written++;
 }
 
 //process
-void process_pipeline( Mat& frame ){
+void process_pipeline( Stream& stream, FrameSlot& slot ){
+	#if DEBUG_SHOW_INPUT
+	if( !HEADLESS )
+		slot.frame.copyTo ( slot.input );
+	#endif
+	ScopedTimer timer ( Timing::PROCESS );
+	stream.processor->process( slot.frame, stream.history->past(), slot.yuv );
+
+	// The past of the next frames, with no copy
+	stream.history->push( slot.frame );
+
+	#if DEBUG_SHOW_GREEN_BLOB
+	if( !HEADLESS )
+		stream.processor->green().copyTo ( slot.green );
+	#endif
+}
+
+//output
+void output_pipeline( Stream& stream, FrameSlot& slot ){
 	static int n_output = 0;
 
+	{
+		ScopedTimer timer ( Timing::OUTPUT );
+		if( async_depth && !stream.output.empty() )
+			stream.writer->submit( slot.frame, [&stream]( const Mat& frame ){
+				ScopedTimer timer ( Timing::WRITE );
+				write_output( stream, frame );
+			} );
+		else
+			write_output( stream, slot.frame );
+	}
+
+	if( HEADLESS )
+		return;
+
+	ScopedTimer timer ( Timing::DISPLAY );
 	#if DEBUG_SHOW_INPUT
-	imshow ( WINDOW_TITLE, frame );
+	imshow ( WINDOW_TITLE, slot.input );
+	#endif
+	#if DEBUG_SHOW_GREEN_BLOB
+	imshow ( DEBUG_WINDOW_TITLE_GREEN_BLOB, slot.green );
 	#endif
-	pipeline( frame );
-	imshow ( WINDOW_TITLE_PROCESSED, frame );
+	imshow ( WINDOW_TITLE_PROCESSED, slot.frame );
 
 	if(WRITE_CURRENT_FRAME){
 		stringstream s;
 		s << filename << DEFAULT_OUTPUT << n_output << ".png";
 
-		imwrite(s.str(), frame);
+		// PNG of a big frame takes tens of ms, the writer encodes it
+		string name = s.str();
+		stream.writer->submit( slot.frame, [name]( const Mat& frame ){
+			ScopedTimer timer ( Timing::WRITE );
+			imwrite( name, frame );
+		}, AsyncWriter::WAIT );
 		WRITE_CURRENT_FRAME = false;
 		n_output++;
 	}
-	
+}
+
+//threads
+void capture_thread( Stream& stream ){
+	FrameRing& ring = *stream.ring;
+	FrameSlot* slot;
+	int64 index = 1; // the first frame was read by open_stream
+
+	// Frames this old are in neither the ring nor the history
+	const size_t in_use = ring.depth() + max( stream.history->delay(), ring.depth() ) + 1;
+
+	while( (slot = ring.acquire( Stage::CAPTURE )) ){
+		bool read;
+
+		// A replay just points the slot to the mapping
+		if( stream.replay ){
+			ScopedTimer timer ( Timing::CAPTURE );
+			read = (size_t) index < stream.raw.size();
+			if( read )
+				slot->frame = stream.raw.frame( index );
+			if( (size_t) index > in_use )
+				stream.raw.release( index - in_use );
+		}else{
+			// The last frame of this slot may be in the history
+			stream.history->take( slot->frame );
+
+			ScopedTimer timer ( Timing::CAPTURE );
+			Mat& decoded = stream.nv12 ? slot->yuv : slot->frame;
+			read = stream.cap.isOpened() && stream.cap.read( decoded ) && decoded.data;
+		}
+
+		// The green is found in the NV12 planes, the rest wants BGR
+		if( read && stream.nv12 ){
+			ScopedTimer timer ( Timing::CONVERT );
+			cvtColor( slot->yuv, slot->frame, CV_YUV2BGR_NV12 );
+		}
+
+		if( read && stream.record.is_open() )
+			stream.record.write( slot->frame );
+
+		if( !read ){
+			ring.close();
+			break;
+		}
+
+		slot->index = index++;
+		ring.commit( Stage::CAPTURE );
+	}
+}
+
+void process_thread( Stream& stream ){
+	FrameSlot* slot;
+
+	while( (slot = stream.ring->acquire( Stage::PROCESS )) ){
+		process_pipeline( stream, *slot );
+		stream.ring->commit( Stage::PROCESS );
+	}
+}
+
+//! After the output of every frame, of any stream.
+void frame_done(){
+	int n = ++frames_out;
+	if( Timing::enabled && stats_every && n % stats_every == 0 )
+		Timing::dump( stats_file );
+}
+
+//! Output of a stream with no windows, that needs no HighGUI thread.
+void output_thread( Stream& stream ){
+	FrameSlot* slot;
+
+	while( (slot = stream.ring->acquire( Stage::OUTPUT )) ){
+		output_pipeline( stream, *slot );
+		stream.n_frames++;
+		stream.ring->commit( Stage::OUTPUT );
+		frame_done();
+	}
+}
+
+/** @fn bool open_capture ( Stream& stream, const string& source, Mat& frame, Mat& decoded )
+  *
+  * @brief	Opens the VideoCapture of `source` and reads the first frame,
+  *		in BGR in `frame` and, if it came as NV12, so in `decoded`.
+  */
+bool open_capture( Stream& stream, const string& source, Mat& frame, Mat& decoded ){
+	if( source.find_first_not_of( "0123456789" ) == string::npos )
+		stream.cap.open( atoi( source.c_str() ) );
+	else
+		stream.cap.open( source );
+
+	if( yuv_input && stream.cap.isOpened() )
+		stream.cap.set( CV_CAP_PROP_CONVERT_RGB, 0 );
+
+	if( !( stream.cap.isOpened() && stream.cap.read( decoded ) && decoded.data ) )
+		return false;
+
+	// One plane of Y and half of U and V, or BGR if the backend converts anyway
+	stream.nv12 = yuv_input && decoded.type() == CV_8UC1 && decoded.rows % 3 == 0 && decoded.cols % 2 == 0;
+	if( stream.nv12 )
+		cvtColor( decoded, frame, CV_YUV2BGR_NV12 );
+	else if( decoded.type() == CV_8UC3 )
+		frame = decoded;
+	else{
+		cerr << source << ": the decoder gives neither NV12 nor BGR, run it without -y" << endl;
+		return false;
+	}
+
+	if( yuv_input && !stream.nv12 )
+		cerr << source << ": not decoded as NV12, the green is found in BGR" << endl;
+
+	if( stream.cap.get( CV_CAP_PROP_FPS ) > 0 )
+		stream.fps = stream.cap.get( CV_CAP_PROP_FPS );
+	return true;
+}
+
+/** @fn bool open_output ( Stream& stream, Size size, int type )
+  *
+  * @brief	Opens the video file or the container of the output of
+  *		`stream`, if it has one, for frames of `size` and `type`.
+  *		The image sequences need nothing opened before the first
+  *		frame.
+  *
+  * @return	false, with the reason on cerr, if the file could not be
+  *		opened.
+  */
+bool open_output( Stream& stream, Size size, int type ){
+	if( stream.output.empty() || stream.output.find('%') != string::npos )
+		return true;
+
+	if( is_raw_frames( stream.output ) )
+		return stream.raw_output.open( stream.output, size, type, stream.fps );
+
+	stream.video.open( stream.output, OUTPUT_FOURCC, stream.fps, size );
+	if( !stream.video.isOpened() ){
+		cerr << stream.output << ": cannot write the video, check the path and the codec" << endl;
+		return false;
+	}
+	return true;
+}
+
+/** @fn bool open_stream ( Stream& stream, const string& source, const string& record )
+  *
+  * @brief	Opens `source`, a video file, a container of raw frames or,
+  *		if it is a number, a camera, and puts its first frame in the
+  *		first slot of a new ring. With -y, asks for the frames as
+  *		decoded, and keeps them so if they come as NV12.
+  *
+  * @param record	If not empty, the container where every frame
+  *			captured is written.
+  *
+  * @return	Whether the first frame could be read, and the output of
+  *		the stream and `record` opened.
+  */
+bool open_stream( Stream& stream, const string& source, const string& record ){
+	stream.source = source;
+
+	Mat frame, decoded;
+	if( is_raw_frames( source ) ){
+		if( !stream.raw.open( source ) || !stream.raw.size() )
+			return false;
+
+		stream.replay = true;
+		frame = stream.raw.frame( 0 );
+		if( frame.type() != CV_8UC3 ){
+			cerr << source << ": the frames are not BGR" << endl;
+			return false;
+		}
+		if( stream.raw.fps() > 0 )
+			stream.fps = stream.raw.fps();
+	}
+	else if( !open_capture( stream, source, frame, decoded ) )
+		return false;
+
+	if( !record.empty() && !( stream.record.open( record, frame.size(), frame.type(), stream.fps ) && stream.record.write( frame ) ) )
+		return false;
+
+	if( !open_output( stream, frame.size(), frame.type() ) )
+		return false;
+
+	stream.ring.reset( new FrameRing( ring_depth, frame.size(), frame.type() ) );
+	FrameSlot* slot = stream.ring->acquire( Stage::CAPTURE );
+	slot->frame = frame;
+	if( stream.nv12 )
+		slot->yuv = decoded;
+	slot->index = 0;
+	stream.ring->commit( Stage::CAPTURE );
+
+	stream.history.reset( new FrameHistory( past_delay, stream.ring->depth(), history_budget ) );
+	stream.processor.reset( new Processor( shared_pool(), settings ) );
+	return true;
+}
+
+/** @fn string stream_output ( const string& output, size_t i, size_t n )
+  *
+  * @return	The output of the stream `i` of `n`: `output` itself for one
+  *		stream, else with _i before the extension (out_2.avi).
+  */
+string stream_output( const string& output, size_t i, size_t n ){
+	if( output.empty() || n == 1 )
+		return output;
+
+	size_t dot = output.rfind( '.' );
+	size_t slash = output.rfind( '/' );
+	if( dot == string::npos || ( slash != string::npos && dot < slash ) )
+		dot = output.size();
+
+	stringstream s;
+	s << output.substr( 0, dot ) << "_" << i << output.substr( dot );
+	return s.str();
 }
 
 bool key_process(){
@@ -114,79 +396,236 @@ bool key_process(){
 	return true;
 }
 
+void usage( const char* bin ){
+	cerr	<< "usage: " << bin << " [-H] [-o output] [-a frames] [-R record] [-r depth] [-j workers] [-t frames] [-p frames] [-m MB] [-s scale] [-c pixels] [-i] [-y] [-g greens] [-T stats] [-E frames] [input...]" << endl
+		<< "  input      video files, containers of raw frames (" RAW_FRAMES_EXTENSION "), replayed" << endl
+		<< "             with no decoding, or camera numbers, the webcam if omitted;" << endl
+		<< "             with more than one they are processed at once, headless" << endl
+		<< "  -H         headless: no windows, process every frame as fast as possible" << endl
+		<< "  -o output  write every processed frame to a video file or to an" << endl
+		<< "             image sequence, if it has a printf pattern (out_%05d.png);" << endl
+		<< "             with many inputs, the i-th gets _i before the extension;" << endl
+		<< "             raw frames if it ends with " RAW_FRAMES_EXTENSION << endl
+		<< "  -a frames  write the output in a thread of its own, from up to `frames`" << endl
+		<< "             copies of the frames; when the disk falls behind, the frames" << endl
+		<< "             with no copy free are dropped instead of slowing the capture," << endl
+		<< "             for recordings of live sessions (default 0: no thread)" << endl
+		<< "  -R record  write every frame as captured, before the processing, to a" << endl
+		<< "             container of raw frames, to replay the run later" << endl
+		<< "  -r depth   frames in flight between the capture, processing and" << endl
+		<< "             output threads (default " << FRAME_RING_DEFAULT_DEPTH << ")" << endl
+		<< "  -j workers threads that process the green regions of the frames besides" << endl
+		<< "             the processing threads, shared by all the inputs (default "
+		<< roi_workers << ")" << endl
+		<< "  -t frames  track the cards found, searching the whole frame only" << endl
+		<< "             every `frames` frames or when one is lost (default 1: always)" << endl
+		<< "  -p frames  how many frames ago is the past shown in the cards (default "
+		<< FRAME_HISTORY_DEFAULT_DELAY << ")" << endl
+		<< "  -m MB      memory for the past frames; the older ones that do not fit" << endl
+		<< "             are kept smaller (default: no limit)" << endl
+		<< "  -s scale   search the cards in a frame 2 or 4 times smaller, and" << endl
+		<< "             refine their corners in the full frame (default 1)" << endl
+		<< "  -c pixels  how far from the scaled corners they are refined" << endl
+		<< "             (default twice the scale)" << endl
+		<< "  -i         fixed camera: recompute the green mask of the full detection" << endl
+		<< "             only in the tiles of the frame that changed" << endl
+		<< "  -y         find the green in the frames as decoded, NV12, when the" << endl
+		<< "             decoder gives them so; every frame is still converted to" << endl
+		<< "             BGR, in the capture thread, for the cards and the output" << endl
+		<< "  -g greens  file with the green thresholds, `key value` lines:" << endl
+		<< "             `preset default|narrow|dim`, then any of min_sat, hue," << endl
+		<< "             max_distance, min_bright and threshold to change" << endl
+		<< "  -T stats   write p50, p95, p99 and max latency of every stage at the" << endl
+		<< "             end, as JSON if `stats` ends with .json, CSV otherwise" << endl
+		<< "  -E frames  also write the stats every `frames` frames (default 0: no)" << endl;
+}
+
 int main( int argc, char* argv[] ){
 	DEBUG("Hello world of debugging, I'm Hold Your Past!", 0);
 
-	// Open a file passed by argument or open the webcam
-	VideoCapture cap;
+	// -1 for twice the pyramid scale, whatever comes first
+	settings.refine_radius = -1;
+	settings.draw_corners = DEBUG_SHOW_CORNERS;
+
+	int opt;
+	while( (opt = getopt( argc, argv, "Ho:a:R:r:j:t:p:m:s:c:iyg:T:E:h" )) != -1 ){
+		switch( opt ){
+			case 'H':
+				HEADLESS = true;
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 'a':
+				async_depth = max( atoi( optarg ), 0 );
+				break;
+			case 'R':
+				record_file = optarg;
+				break;
+			case 'r':
+				ring_depth = max( atoi( optarg ), 1 );
+				break;
+			case 'j':
+				roi_workers = max( atoi( optarg ), 0 );
+				break;
+			case 't':
+				settings.track_interval = max( atoi( optarg ), 1 );
+				break;
+			case 'p':
+				past_delay = max( atoi( optarg ), 1 );
+				break;
+			case 'm':
+				history_budget = (size_t) max( atoi( optarg ), 0 ) << 20;
+				break;
+			case 's':
+				settings.pyramid_scale = atoi( optarg );
+				if( settings.pyramid_scale != 1 && settings.pyramid_scale != 2 && settings.pyramid_scale != 4 ){
+					cerr << "-s takes 1, 2 or 4" << endl;
+					usage( argv[0] );
+					exit( EXIT_FAILURE );
+				}
+				break;
+			case 'c':
+				settings.refine_radius = max( atoi( optarg ), 0 );
+				break;
+			case 'i':
+				settings.incremental = true;
+				break;
+			case 'y':
+				yuv_input = true;
+				break;
+			case 'g':{
+				GreenThresholds greens;
+				if( !load_green_thresholds( optarg, greens ) )
+					exit( EXIT_FAILURE );
+				GreenClassifier::configure( greens );
+				break;
+			}
+			case 'T':
+				stats_file = optarg;
+				Timing::enabled = true;
+				break;
+			case 'E':
+				stats_every = max( atoi( optarg ), 0 );
+				break;
+			default:
+				usage( argv[0] );
+				exit( opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE );
+		}
+	}
 
-	if(argc == 2) {
-		filename = argv[1];
-		cap = VideoCapture(filename);
-	}else
-		cap = VideoCapture(0);
+	if( settings.refine_radius < 0 )
+		settings.refine_radius = 2*settings.pyramid_scale;
+
+	// The sources passed by argument, or the webcam
+	vector<string> sources ( argv + optind, argv + argc );
+	if( sources.empty() )
+		sources.push_back( "0" );
+	else if( sources.size() == 1 )
+		filename = sources[0];
+
+	// HighGUI only shows one stream
+	if( sources.size() > 1 )
+		HEADLESS = true;
+
+	vector< unique_ptr<Stream> > streams;
+	for ( size_t i = 0; i < sources.size(); i++ ){
+		unique_ptr<Stream> stream ( new Stream );
+		stream->output = stream_output( output, i, sources.size() );
+		if( !open_stream( *stream, sources[i], stream_output( record_file, i, sources.size() ) ) ){
+			cerr << "Erro, não pôde abrir a imagem: " << sources[i] << endl;
+			continue;
+		}
 
-	Mat frame;
+		if( async_depth || !HEADLESS )
+			stream->writer.reset( new AsyncWriter( async_depth ? async_depth : ASYNC_WRITER_DEFAULT_DEPTH ) );
+		streams.push_back( move( stream ) );
+	}
 
-	// Read first frame
-	if( !( cap.isOpened() && cap.read( frame ) && frame.data ) ){
-		cerr << "Erro, não pôde abrir a imagem" << endl;
+	if( streams.empty() )
 		exit( EXIT_FAILURE );
-	}
+
+	// Build the green table now, not on the first processed frame
+	GreenClassifier::get();
 
 	// Window create
-	// Main window
-	namedWindow ( WINDOW_TITLE_PROCESSED,	CV_WINDOW_NORMAL );
+	if( !HEADLESS ){
+		// Main window
+		namedWindow ( WINDOW_TITLE_PROCESSED,	CV_WINDOW_NORMAL );
 
-	// Input window
-	#if DEBUG_SHOW_INPUT
-	namedWindow ( WINDOW_TITLE,		CV_WINDOW_NORMAL );
-	#endif
+		// Input window
+		#if DEBUG_SHOW_INPUT
+		namedWindow ( WINDOW_TITLE,		CV_WINDOW_NORMAL );
+		#endif
 
-	// Green blob window
-	#if DEBUG_SHOW_GREEN_BLOB
-	namedWindow ( DEBUG_WINDOW_TITLE_GREEN_BLOB, CV_WINDOW_NORMAL );
-	#endif
+		// Green blob window
+		#if DEBUG_SHOW_GREEN_BLOB
+		namedWindow ( DEBUG_WINDOW_TITLE_GREEN_BLOB, CV_WINDOW_NORMAL );
+		#endif
+	}
 
-	// Process the first frame
-	process_pipeline ( frame );
+	int64 start = getTickCount();
 
-	// While frames are coming...
-	while( cap.isOpened() && cap.read( frame ) && frame.data && key_process() ){
-		process_pipeline ( frame );
+	vector<thread> threads;
+	for ( size_t i = 0; i < streams.size(); i++ ){
+		threads.push_back( thread( capture_thread, ref( *streams[i] ) ) );
+		threads.push_back( thread( process_thread, ref( *streams[i] ) ) );
+		if( HEADLESS )
+			threads.push_back( thread( output_thread, ref( *streams[i] ) ) );
 	}
-	
-	// Wait exit
-	while(key_process());
-	cap.release();
-	destroyAllWindows();
-	DEBUG("Bye world of debugging!", 0);
-	return 0;
-}
 
-void draw_point ( Mat& frame, vector<Quadrilateral>& vec ){
+	// With windows, the output of the only stream stays in this thread, HighGUI wants it
+	if( !HEADLESS ){
+		Stream& stream = *streams[0];
+		FrameSlot* slot;
 
-	Scalar s[4] = 	{
-				Scalar(255, 0, 0),
-				Scalar(0, 255, 0),
-				Scalar(0, 0, 255),
-				Scalar(0, 255, 255)
-			};
+		while( (slot = stream.ring->acquire( Stage::OUTPUT )) ){
+			output_pipeline( stream, *slot );
+			stream.n_frames++;
+			stream.ring->commit( Stage::OUTPUT );
+			frame_done();
 
-	for(size_t i=0; i<vec.size(); i++){
-
-		for (size_t j=0; j< 4 ; j++){
-			circle(frame, vec[i][j], 4, s[j], 2);
+			if( !key_process() )
+				stream.ring->abort();
 		}
 	}
-}
 
-void 	draw_point ( Mat& img, vector<Point>& vec, Scalar s ){
-	for(size_t i=0; i<vec.size(); i++){
-		for (size_t j=0; j< 4 ; j++){
-			circle(img, vec[i], 4, s, 2);
+	for ( size_t i = 0; i < threads.size(); i++ )
+		threads[i].join();
+
+	// The frames still queued are written before the time is taken, and
+	// the containers get their count; a disk that failed fails the run
+	bool written = true;
+	for ( size_t i = 0; i < streams.size(); i++ ){
+		if( streams[i]->writer ){
+			streams[i]->writer->flush();
+			if( streams[i]->writer->dropped() )
+				cerr	<< streams[i]->source << ": " << streams[i]->writer->dropped()
+					<< " frames dropped from the output, the disk fell behind" << endl;
 		}
+		written = streams[i]->raw_output.close() && written;
+		written = streams[i]->record.close() && written;
 	}
 
-}
+	double seconds = (getTickCount() - start) / getTickFrequency();
+	if( streams.size() > 1 )
+		for ( size_t i = 0; i < streams.size(); i++ )
+			cout	<< streams[i]->source << ": " << streams[i]->n_frames << " frames, "
+				<< streams[i]->n_frames / seconds << " fps" << endl;
 
+	cout	<< frames_out << " frames in " << seconds << " s, "
+		<< frames_out / seconds << " fps" << endl;
+
+	if( Timing::enabled && !Timing::dump( stats_file ) )
+		cerr << "could not write the stats to " << stats_file << endl;
+
+	// Wait exit
+	if( !HEADLESS ){
+		while(key_process());
+		destroyAllWindows();
+	}
+	for ( size_t i = 0; i < streams.size(); i++ )
+		streams[i]->cap.release();
+	DEBUG("Bye world of debugging!", 0);
+	return written ? 0 : EXIT_FAILURE;
+}
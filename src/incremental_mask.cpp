@@ -0,0 +1,151 @@
+/** @file incremental_mask.cpp
+  * @brief green mask of a fixed camera, recomputed only in the tiles of the frame that changed.
+  */
+//--INCLUDES--------------------------------------------------
+#include <incremental_mask.hpp>
+#include <HYP.hpp>
+#include <green_classifier.hpp>
+#include <stage_timer.hpp>
+
+#include <cstring>
+
+//--MACROS----------------------------------------------------
+// How far a change reaches in the median blur, and then in the dilation
+#define MEDIAN_REACH	( BGREEN_MEDIAN_BLUR_WIN / 2 )
+#define DILATE_REACH	( BGREEN_DILATE_SIZE / 2 )
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+/** @fn IncrementalMask::IncrementalMask ( int tile )
+  *
+  * @param tile		Side of the tiles. Smaller tiles recompute less around
+  *			a change, but the halos and the calls are more.
+  */
+IncrementalMask::IncrementalMask ( int tile ) :
+	tile ( max( tile, 1 ) ), n_changed ( 0 ), n_tiles ( 0 ){
+}
+
+/** @fn const Mat& IncrementalMask::update ( const Mat& frame )
+  *
+  * @param frame	BGR frame, of the same camera as the last one.
+  *
+  * @return	The mask of best_green( frame ). Valid until the next call.
+  */
+const Mat& IncrementalMask::update ( const Mat& frame ){
+	// Nothing to compare with
+	if( frame.size() != previous.size() || frame.type() != previous.type() ){
+		full( frame );
+		return result;
+	}
+
+	{
+		ScopedTimer timer ( Timing::FRAME_DIFF );
+		find_changes( frame );
+	}
+
+	// Most of the frame changed: the halos would cost more than they save
+	if( n_changed > n_tiles * INCREMENTAL_MASK_FULL_RATIO ){
+		full( frame );
+		return result;
+	}
+
+	const Rect whole ( Point(0, 0), frame.size() );
+
+	{
+		ScopedTimer timer ( Timing::CLASSIFY );
+		for ( size_t i=0; i<runs.size(); i++ ){
+			// The whole words of the run: the frame is the same around it
+			const int x0 = runs[i].x / BIT_MASK_WORD * BIT_MASK_WORD;
+			const int x1 = min( frame.cols, ( runs[i].x + runs[i].width + BIT_MASK_WORD - 1 ) / BIT_MASK_WORD * BIT_MASK_WORD );
+			const Rect words ( x0, runs[i].y, x1 - x0, runs[i].height );
+
+			GreenClassifier::get().classify( Mat(frame, words), classified, words.tl() );
+		}
+	}
+
+	ScopedTimer timer ( Timing::BLUR_DILATE );
+
+	// Every blur first: the dilation of a run reads the blur of its neighbours
+	const int m = MEDIAN_REACH, d = DILATE_REACH;
+	for ( size_t i=0; i<runs.size(); i++ )
+		bit_median( classified, blurred, BGREEN_MEDIAN_BLUR_WIN,
+			Rect( runs[i].x - m, runs[i].y - m, runs[i].width + 2*m, runs[i].height + 2*m ) & whole );
+
+	for ( size_t i=0; i<runs.size(); i++ ){
+		Rect target = Rect( runs[i].x - m - d, runs[i].y - m - d, runs[i].width + 2*(m + d), runs[i].height + 2*(m + d) ) & whole;
+		bit_dilate( blurred, dilated, BGREEN_DILATE_SIZE, target );
+		dilated.unpack( result, target );
+	}
+
+	return result;
+}
+
+//! The mask of the whole frame, as best_green() does it, keeping every step.
+void IncrementalMask::full ( const Mat& frame ){
+	frame.copyTo( previous );
+	n_tiles = (size_t) ( (frame.cols + tile - 1) / tile ) * ( (frame.rows + tile - 1) / tile );
+	n_changed = n_tiles;
+
+	{
+		ScopedTimer timer ( Timing::CLASSIFY );
+		GreenClassifier::get().classify( frame, classified );
+	}
+
+	ScopedTimer timer ( Timing::BLUR_DILATE );
+	bit_median( classified, blurred, BGREEN_MEDIAN_BLUR_WIN );
+	bit_dilate( blurred, dilated, BGREEN_DILATE_SIZE );
+	dilated.unpack( result );
+}
+
+/** @fn void IncrementalMask::find_changes ( const Mat& frame )
+  *
+  * @brief	Compares every tile of `frame` with the last frame, row by
+  *		row until one differs, and copies the changed ones over it.
+  *		The changed tiles next to each other in a row of tiles are
+  *		left in `runs` as one rectangle.
+  */
+void IncrementalMask::find_changes ( const Mat& frame ){
+	const int tiles_x = (frame.cols + tile - 1) / tile;
+	const int tiles_y = (frame.rows + tile - 1) / tile;
+	const size_t pixel = frame.elemSize();
+
+	runs.clear();
+	n_changed = 0;
+	n_tiles = (size_t) tiles_x * tiles_y;
+
+	for ( int ty = 0; ty < tiles_y; ty++ ){
+		const int y0 = ty*tile, y1 = min( y0 + tile, frame.rows );
+		int run = -1;	// first tile of the run in this row
+
+		// One past the last tile, to end the last run
+		for ( int tx = 0; tx <= tiles_x; tx++ ){
+			bool changed = false;
+
+			if( tx < tiles_x ){
+				const int x0 = tx*tile, x1 = min( x0 + tile, frame.cols );
+				const size_t offset = x0*pixel, bytes = (x1 - x0)*pixel;
+
+				int y = y0;
+				while( y < y1 && !memcmp( frame.ptr(y) + offset, previous.ptr(y) + offset, bytes ) )
+					y++;
+
+				// The rows before the first different one are already equal
+				changed = y < y1;
+				for ( ; y < y1; y++ )
+					memcpy( previous.ptr(y) + offset, frame.ptr(y) + offset, bytes );
+			}
+
+			if( changed ){
+				n_changed++;
+				if( run < 0 )
+					run = tx;
+			}else if( run >= 0 ){
+				const int x0 = run*tile, x1 = min( tx*tile, frame.cols );
+				runs.push_back( Rect( x0, y0, x1 - x0, y1 - y0 ) );
+				run = -1;
+			}
+		}
+	}
+}
@@ -0,0 +1,145 @@
+/** @file labeler.cpp
+  * @brief single pass connected component labeling of the green mask.
+  */
+//--INCLUDES--------------------------------------------------
+#include <labeler.hpp>
+
+#include <cstring>
+#include <stdint.h>
+
+//--MACROS----------------------------------------------------
+#define FOREGROUND	255
+#define LABELED		127
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+/** @fn void ComponentLabeler::begin ()
+  *
+  * @brief	Forgets the last image. The buffers keep their memory.
+  */
+void ComponentLabeler::begin (){
+	prev.clear();
+	cur.clear();
+	parent.clear();
+	stats.clear();
+	row = 0;
+}
+
+//! Root of the component of `label`, halving the path on the way.
+int ComponentLabeler::find ( int label ){
+	while( parent[label] != label ){
+		parent[label] = parent[ parent[label] ];
+		label = parent[label];
+	}
+	return label;
+}
+
+//! Joins two roots. The oldest label stays as root and gets the statistics.
+int ComponentLabeler::unite ( int a, int b ){
+	if( a == b )
+		return a;
+	if( b < a )
+		swap( a, b );
+
+	parent[b] = a;
+
+	Stats& s = stats[a];
+	const Stats& o = stats[b];
+	s.x0 = min( s.x0, o.x0 );
+	s.y0 = min( s.y0, o.y0 );
+	s.x1 = max( s.x1, o.x1 );
+	s.y1 = max( s.y1, o.y1 );
+	s.pixels += o.pixels;
+
+	return a;
+}
+
+/** @fn void ComponentLabeler::add_rows ( Mat& band )
+  *
+  * @brief	Labels the rows of `band`, that come right below the rows
+  *		already added. Every 255 of the band becomes 127.
+  *
+  * @param band	One channel band of the mask, always of the same width.
+  */
+void ComponentLabeler::add_rows ( Mat& band ){
+	for ( int i = 0; i < band.rows; i++, row++ ){
+		uchar* ptr = band.ptr<uchar>(i);
+		const int width = band.cols;
+
+		// Split the row in runs, painting them
+		cur.clear();
+		for ( int x = 0; x < width; ){
+			// Skip the background, eight pixels at a time while it is all zero
+			uint64_t word;
+			while( x + 8 <= width && ( memcpy( &word, ptr + x, 8 ), word == 0 ) )
+				x += 8;
+			while( x < width && ptr[x] != FOREGROUND )
+				x++;
+			if( x == width )
+				break;
+
+			Run run;
+			run.x0 = x;
+			while( x < width && ptr[x] == FOREGROUND )
+				ptr[x++] = LABELED;
+			run.x1 = x;
+			run.label = -1;
+			cur.push_back( run );
+		}
+
+		// Connect every run with the runs above it that share a column
+		size_t p = 0;
+		for ( size_t c = 0; c < cur.size(); c++ ){
+			Run& run = cur[c];
+
+			while( p < prev.size() && prev[p].x1 <= run.x0 )
+				p++;
+
+			int label = -1;
+			for ( size_t q = p; q < prev.size() && prev[q].x0 < run.x1; q++ ){
+				int l = find( prev[q].label );
+				label = label < 0 ? l : unite( label, l );
+			}
+
+			// A new component
+			if( label < 0 ){
+				label = parent.size();
+				parent.push_back( label );
+
+				Stats s = { run.x0, row, run.x1 - 1, row, 0 };
+				stats.push_back( s );
+			}
+
+			Stats& s = stats[label];
+			s.x0 = min( s.x0, run.x0 );
+			s.x1 = max( s.x1, run.x1 - 1 );
+			s.y1 = row;
+			s.pixels += run.x1 - run.x0;
+
+			run.label = label;
+		}
+
+		prev.swap( cur );
+	}
+}
+
+/** @fn void ComponentLabeler::finish ( vector<Blob>& blobs )
+  *
+  * @param blobs	All the blobs, in the order their first pixel appears.
+  */
+void ComponentLabeler::finish ( vector<Blob>& blobs ){
+	blobs.clear();
+
+	for ( size_t l = 0; l < parent.size(); l++ ){
+		if( parent[l] != (int) l )
+			continue;
+
+		const Stats& s = stats[l];
+		Blob b;
+		b.rect = Rect( s.x0, s.y0, s.x1 - s.x0 + 1, s.y1 - s.y0 + 1 );
+		b.pixels = s.pixels;
+		blobs.push_back( b );
+	}
+}
@@ -8,6 +8,10 @@
 
 #include "line2d.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace cv;
 
 /*============================================================================*/
@@ -193,4 +197,164 @@ float LineSegment2d::shortestDistanceTo (Point2f pt)
 	return (sqrtf ((pt.x - proj.x)*(pt.x - proj.x) + (pt.y - proj.y)*(pt.y - proj.y)));
 }
 
+/*----------------------------------------------------------------------------*/
+/** Squared shortest distances between the line segment and n points, with
+ * no branch: the projection is clamped to the segment with min and max
+ * instead of testing on which side of it the point is. Shared by
+ * shortestDistancesTo () and farthestOf ().
+ *
+ * Parameters: float cx, cy: pt2 - pt1.
+ *            float inv: 1 / (length*length), 0 for a single point.
+ *            float x, y: coordinates of the point.
+ *
+ * Return value: the squared distance. */
+
+static inline float squaredDistance (Point2f pt1, float cx, float cy, float inv, float x, float y)
+{
+	float ax = x - pt1.x, ay = y - pt1.y;
+	float t = std::min (std::max ((ax*cx + ay*cy) * inv, 0.0f), 1.0f);
+	float px = ax - t*cx, py = ay - t*cy;
+	return (px*px + py*py);
+}
+
+#ifdef __SSE2__
+static inline __m128 squaredDistance4 (__m128 x1, __m128 y1, __m128 cx, __m128 cy, __m128 inv, __m128 x, __m128 y)
+{
+	__m128 ax = _mm_sub_ps (x, x1), ay = _mm_sub_ps (y, y1);
+	__m128 t = _mm_mul_ps (_mm_add_ps (_mm_mul_ps (ax, cx), _mm_mul_ps (ay, cy)), inv);
+	t = _mm_min_ps (_mm_max_ps (t, _mm_setzero_ps ()), _mm_set1_ps (1.0f));
+	__m128 px = _mm_sub_ps (ax, _mm_mul_ps (t, cx)), py = _mm_sub_ps (ay, _mm_mul_ps (t, cy));
+	return (_mm_add_ps (_mm_mul_ps (px, px), _mm_mul_ps (py, py)));
+}
+#endif
+
+/*----------------------------------------------------------------------------*/
+/** Shortest distances between the line segment and n points, as
+ * shortestDistanceTo () for each one, but a single point segment gives the
+ * distance to it.
+ *
+ * Parameters: const float* x: x coordinates of the points.
+ *            const float* y: y coordinates of the points.
+ *            int n: number of points.
+ *            float* dist: the n distances are stored here. */
+
+void LineSegment2d::shortestDistancesTo (const float* x, const float* y, int n, float* dist) const
+{
+	const float cx = pt2.x - pt1.x, cy = pt2.y - pt1.y;
+	const float inv = (length > 0)? 1.0f / (length*length) : 0.0f;
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128 x1 = _mm_set1_ps (pt1.x), y1 = _mm_set1_ps (pt1.y);
+	const __m128 cx4 = _mm_set1_ps (cx), cy4 = _mm_set1_ps (cy), inv4 = _mm_set1_ps (inv);
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps (dist + i, _mm_sqrt_ps (squaredDistance4 (x1, y1, cx4, cy4, inv4, _mm_loadu_ps (x + i), _mm_loadu_ps (y + i))));
+#endif
+
+	for (; i < n; i++)
+		dist [i] = sqrtf (squaredDistance (pt1, cx, cy, inv, x [i], y [i]));
+}
+
+/*----------------------------------------------------------------------------*/
+/** Finds the point farthest from the line segment. The squared distances are
+ * compared, each lane keeping its greatest one and where it was, and only
+ * the winner has a square root.
+ *
+ * Parameters: const float* x: x coordinates of the points.
+ *            const float* y: y coordinates of the points.
+ *            int n: number of points.
+ *            float* dist: if not NULL, the distance of the farthest point.
+ *
+ * Return value: index of the farthest point, the first one if there is a
+ *               tie, -1 if n is 0. */
+
+int LineSegment2d::farthestOf (const float* x, const float* y, int n, float* dist) const
+{
+	const float cx = pt2.x - pt1.x, cy = pt2.y - pt1.y;
+	const float inv = (length > 0)? 1.0f / (length*length) : 0.0f;
+	float best = -1;
+	int best_index = -1;
+	int i = 0;
+
+#ifdef __SSE2__
+	if (n >= 4)
+	{
+		const __m128 x1 = _mm_set1_ps (pt1.x), y1 = _mm_set1_ps (pt1.y);
+		const __m128 cx4 = _mm_set1_ps (cx), cy4 = _mm_set1_ps (cy), inv4 = _mm_set1_ps (inv);
+		__m128 best4 = _mm_set1_ps (-1.0f);
+		__m128i index4 = _mm_setzero_si128 ();
+		__m128i current = _mm_set_epi32 (3, 2, 1, 0);
+		const __m128i step = _mm_set1_epi32 (4);
+
+		for (; i + 4 <= n; i += 4, current = _mm_add_epi32 (current, step))
+		{
+			__m128 d = squaredDistance4 (x1, y1, cx4, cy4, inv4, _mm_loadu_ps (x + i), _mm_loadu_ps (y + i));
+			__m128 greater = _mm_cmpgt_ps (d, best4); // Strictly, so each lane keeps its first maximum.
+			best4 = _mm_or_ps (_mm_and_ps (greater, d), _mm_andnot_ps (greater, best4));
+			__m128i take = _mm_castps_si128 (greater);
+			index4 = _mm_or_si128 (_mm_and_si128 (take, current), _mm_andnot_si128 (take, index4));
+		}
+
+		// The greatest of the lanes, the smallest index among equals.
+		float lanes [4];
+		int indices [4];
+		_mm_storeu_ps (lanes, best4);
+		_mm_storeu_si128 ((__m128i*) indices, index4);
+		for (int k = 0; k < 4; k++)
+			if (lanes [k] > best || (lanes [k] == best && indices [k] < best_index))
+			{
+				best = lanes [k];
+				best_index = indices [k];
+			}
+	}
+#endif
+
+	for (; i < n; i++)
+	{
+		float d = squaredDistance (pt1, cx, cy, inv, x [i], y [i]);
+		if (d > best)
+		{
+			best = d;
+			best_index = i;
+		}
+	}
+
+	if (dist)
+		*dist = (best_index >= 0)? sqrtf (best) : 0;
+	return (best_index);
+}
+
+/*============================================================================*/
+/* LineSegment2i CLASS                                                        */
+/*============================================================================*/
+/** Constructor. Creates a line segment between two integer points. Nothing
+ * but the differences and the squared length is computed.
+ *
+ * Parameters: Point pt1: a point.
+ *            Point pt2: another point. */
+
+LineSegment2i::LineSegment2i (Point pt1, Point pt2)
+{
+	this->pt1 = pt1;
+	this->pt2 = pt2;
+	dx = pt2.x - pt1.x;
+	dy = pt2.y - pt1.y;
+	squaredLength = dx*dx + dy*dy;
+}
+
+/*----------------------------------------------------------------------------*/
+/** Turns a scaledDistanceTo () back into a distance, for comparing it with
+ * the distances to other segments. Once per segment, not per point.
+ *
+ * Parameters: int64 scaled: a value of scaledDistanceTo ().
+ *
+ * Return value: the distance. */
+
+float LineSegment2i::distanceFromScaled (int64 scaled) const
+{
+	if (squaredLength == 0) // A single point: the value was not scaled.
+		return ((float) sqrt ((double) scaled));
+	return ((float) sqrt ((double) scaled / (double) squaredLength));
+}
+
 /*============================================================================*/
@@ -0,0 +1,196 @@
+/** @file logger.cpp
+  * @brief non blocking log: fixed size records go through a lock free ring to a thread that writes them.
+  */
+//--INCLUDES--------------------------------------------------
+#include <logger.hpp>
+
+#include <iostream>
+#include <streambuf>
+
+//--MACROS----------------------------------------------------
+//colors
+#define _NONE	"\033[0m"
+#define _GRAY	"\033[38;5;247m"
+#define _RED	"\033[1;31m"
+#define _YELLOW	"\033[1;33m"
+#define _BLUE	"\033[38;5;26m"
+
+#ifdef DEBUG_COLOR_ENABLE
+	#define GRAY(X)		_GRAY << X << _NONE
+	#define RED(X)		_RED << X << _NONE
+	#define YELLOW(X)	_YELLOW << X << _NONE
+	#define BLUE(X)		_BLUE << X << _NONE
+#else
+	#define GRAY(X) X
+	#define RED(X) X
+	#define YELLOW(X) X
+	#define BLUE(X) X
+#endif
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+
+//! Stream buffer over a fixed array: what does not fit is cut.
+class FixedBuffer : public streambuf {
+public:
+	void reset ( char* begin, size_t size ){
+		setp( begin, begin + size );
+	}
+	size_t length () const {
+		return pptr() - pbase();
+	}
+};
+
+// Where the LogLine of this thread is formatted
+static thread_local FixedBuffer line_buffer;
+static thread_local ostream line_stream ( &line_buffer );
+
+//! Small number of the calling thread, in the order they first log.
+static uint32_t thread_number (){
+	static atomic<uint32_t> next ( 0 );
+	static thread_local uint32_t number = next++;
+	return number;
+}
+
+//--LOGGER----------------------------------------------------
+
+Logger::Logger () : head ( 0 ), tail ( 0 ), dropped ( 0 ), stopping ( false ){
+	for ( size_t i = 0; i < LOG_RING_SIZE; i++ )
+		cells[i].sequence.store( i, memory_order_relaxed );
+
+	start = chrono::steady_clock::now();
+	writer = thread( &Logger::drain, this );
+}
+
+//! Writes what is still in the ring.
+Logger::~Logger (){
+	stopping.store( true, memory_order_release );
+	writer.join();
+}
+
+/** @fn Logger& Logger::get ()
+  *
+  * @return	The only Logger, started with the first message.
+  */
+Logger& Logger::get (){
+	static Logger logger;
+	return logger;
+}
+
+/** @fn void Logger::push ( const LogRecord& record )
+  *
+  * @brief	Copies `record` to the ring, or drops it if the ring is full.
+  *		Lock free: safe from any thread, never waits for the writer.
+  */
+void Logger::push ( const LogRecord& record ){
+	size_t pos = head.load( memory_order_relaxed );
+	Cell* cell;
+
+	for ( ;; ){
+		cell = &cells[ pos & (LOG_RING_SIZE - 1) ];
+		size_t sequence = cell->sequence.load( memory_order_acquire );
+		intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+
+		if( diff == 0 ){
+			// Free for this turn, if no other producer takes it first
+			if( head.compare_exchange_weak( pos, pos + 1, memory_order_relaxed ) )
+				break;
+		}else if( diff < 0 ){
+			// The writer did not empty it yet: full
+			dropped.fetch_add( 1, memory_order_relaxed );
+			return;
+		}else
+			pos = head.load( memory_order_relaxed );
+	}
+
+	cell->record = record;
+	cell->sequence.store( pos + 1, memory_order_release );
+}
+
+//! Takes the oldest record, if it is complete. Only for the writer.
+bool Logger::pop ( LogRecord& record ){
+	Cell& cell = cells[ tail & (LOG_RING_SIZE - 1) ];
+	if( cell.sequence.load( memory_order_acquire ) != tail + 1 )
+		return false;
+
+	record = cell.record;
+	cell.sequence.store( tail + LOG_RING_SIZE, memory_order_release );
+	tail++;
+	return true;
+}
+
+/** @fn void Logger::drain ()
+  *
+  * @brief	The writer: prints every record as the old debug() did,
+  *		with the time in ms and the thread, and flushes once per
+  *		batch. Sleeps LOG_DRAIN_PERIOD_MS when the ring is empty.
+  */
+void Logger::drain (){
+	LogRecord r;
+
+	for ( ;; ){
+		// Everything pushed before the stop is in the ring by now
+		bool stop = stopping.load( memory_order_acquire );
+
+		size_t n = 0;
+		for ( ; pop( r ); n++ ){
+			#ifdef DEBUG_PREFIX_ENABLE
+			cout << RED("DEBUG") << ":";
+			#endif
+
+			cout << "(" << YELLOW(r.level) << ") " << r.time / 1e6 << " #" << r.thread << " ";
+
+			//indent
+			for ( unsigned int i = 0; i < r.level*2u; i++ )
+				cout << ' ';
+
+			cout << BLUE(r.function) << ": " << GRAY(string( r.text, r.length )) << '\n';
+		}
+
+		uint64_t lost = dropped.exchange( 0, memory_order_relaxed );
+		if( lost )
+			cout << lost << " debug messages lost: the ring was full" << '\n';
+
+		if( n || lost )
+			cout.flush();
+
+		if( stop )
+			break;
+
+		this_thread::sleep_for( chrono::milliseconds( LOG_DRAIN_PERIOD_MS ) );
+	}
+}
+
+//--LOG_LINE--------------------------------------------------
+
+LogLine::LogLine ( const char* function, unsigned int level ){
+	record.time = chrono::duration_cast<chrono::nanoseconds>(
+		chrono::steady_clock::now() - Logger::get().origin() ).count();
+	record.function = function;
+	record.thread = thread_number();
+	record.level = level;
+
+	line_buffer.reset( record.text, LOG_TEXT_SIZE );
+}
+
+//! Pushes the message, cut at LOG_TEXT_SIZE bytes.
+LogLine::~LogLine (){
+	record.length = line_buffer.length();
+	Logger::get().push( record );
+}
+
+/** @fn ostream& LogLine::stream ()
+  *
+  * @return	The stream of this thread, that writes in the text of the
+  *		record, with the default format, as a new ostringstream.
+  *		One LogLine at a time per thread: what is written to it
+  *		must not log.
+  */
+ostream& LogLine::stream (){
+	line_stream.clear();
+	line_stream.flags( ios::dec | ios::skipws );
+	line_stream.precision( 6 );
+	line_stream.width( 0 );
+	line_stream.fill( ' ' );
+	return line_stream;
+}
@@ -0,0 +1,238 @@
+/** @file processor.cpp
+  * @brief the whole effect on one stream of frames, with all its buffers kept from a frame to the next.
+  */
+//--INCLUDES--------------------------------------------------
+#include <processor.hpp>
+#include <stage_timer.hpp>
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+/** @fn template <typename Body> void Processor::for_each_roi ( const Body& body )
+  *
+  * @brief	Runs body(i, worker) for every ROI, in parallel.
+  *
+  * The ROIs do not overlap after extend_and_group_bounding_rects, so
+  * every one can be processed by a different worker, each one writing
+  * only inside its own ROI. The grouping only tests the first ROI once
+  * against every group, so that one may still overlap the others: then
+  * it goes alone, first. A template, and not a function, so the body
+  * is not copied to the heap: the lambda given to the pool only refers
+  * to it and fits in a function.
+  */
+template <typename Body>
+void Processor::for_each_roi ( const Body& body ){
+	size_t first = 0;
+	for ( size_t i = 1; i < roi.size() && first == 0; i++ )
+		if( ( roi[0] & roi[i] ).area() > 0 ){
+			body( 0, pool.size() - 1 );
+			first = 1;
+		}
+
+	pool.parallel_for ( roi.size() - first, [&] ( size_t i, size_t worker ){
+		body( first + i, worker );
+	});
+}
+
+/** @fn Processor::Processor ( ThreadPool& pool, const ProcessorSettings& settings )
+  *
+  * @param pool		Runs the ROIs in parallel; may be shared with other
+  *			Processors and must outlive this one.
+  */
+Processor::Processor ( ThreadPool& pool, const ProcessorSettings& settings ) :
+	pool ( pool ), settings ( settings ), tracker ( settings.track_interval ), scratch ( pool.size() ){
+}
+
+/** @fn void Processor::process ( Mat& frame, const Mat& past, const Mat& nv12 )
+  *
+  * @brief	Finds the green quadrilaterals of `frame` and puts `past`
+  *		in them, in place.
+  *
+  * @param past		The frame to show in the cards, of any size; with no
+  *			data the cards are only found.
+  * @param nv12		`frame` as it was decoded, if NV12: the whole frame
+  *			detection classifies its planes instead.
+  */
+void Processor::process ( Mat& frame, const Mat& past, const Mat& nv12 ){
+	yuv = nv12;
+
+	// Search the green only around the quadrilaterals of the last frame
+	bool tracked = !tracker.due() && track( frame );
+
+	// Lost something, or time to look for new cards: the whole frame
+	if( !tracked ){
+		if( settings.pyramid_scale > 1 )
+			detect_coarse( frame );
+		else
+			detect( frame );
+	}
+
+	tracker.update( found, !tracked );
+
+	for_each_roi( [&] ( size_t i, size_t ){
+		Mat frame_roi = Mat(frame, roi[i]);
+		Mat blob_roi  = Mat(green_blob, roi[i]);
+
+		// Every quadrilateral of the ROI, in one walk of its blob
+		if( past.data )
+			replace_quadrilaterals_by_image( frame_roi, past, blob_roi, quadrilateral[i] );
+
+		if( settings.draw_corners )
+			draw_point( frame_roi, quadrilateral[i] );
+	});
+}
+
+/** @fn bool Processor::track ( Mat& frame )
+  *
+  * @return	Whether every tracked quadrilateral was found again, around
+  *		where it was.
+  */
+bool Processor::track ( Mat& frame ){
+	green_blob.create( frame.size(), CV_8UC1 );
+	green_blob.setTo( 0 );
+
+	tracker.windows( frame.size(), roi );
+	{
+		ScopedTimer timer ( Timing::GROUP );
+		extend_and_group_bounding_rects ( roi, green_blob.size() );
+	}
+
+	if( quadrilateral.size() < roi.size() )
+		quadrilateral.resize( roi.size() );
+
+	for_each_roi( [&] ( size_t i, size_t worker ){
+		Mat blob_roi = Mat(green_blob, roi[i]);
+		green_roi ( Mat(frame, roi[i]), blob_roi, scratch[worker] );
+
+		find_roi_quadrilaterals ( blob_roi, scratch[worker], quadrilateral[i] );
+	});
+
+	gather();
+	return tracker.found_again( found );
+}
+
+/** @fn void Processor::detect_coarse ( Mat& frame )
+  *
+  * @brief	Finds the green and the quadrilaterals in a frame
+  *		pyramid_scale times smaller, then classifies only the ROIs
+  *		again at full resolution and refines the corners there.
+  */
+void Processor::detect_coarse ( Mat& frame ){
+	const int s = settings.pyramid_scale;
+	const Rect whole ( Point(0, 0), frame.size() );
+
+	// Find the green and the ROIs in a smaller frame
+	{
+		ScopedTimer timer ( Timing::DOWNSCALE );
+		// Never empty, even if the frame is smaller than the scale
+		resize( frame, small, Size( max( frame.cols / s, 1 ), max( frame.rows / s, 1 ) ), 0, 0, INTER_AREA );
+	}
+	find_green( small, small_green );
+
+	coarse.clear();
+	find_connected_components ( small_green, coarse, s );
+	{
+		ScopedTimer timer ( Timing::GROUP );
+		extend_and_group_bounding_rects ( coarse, small.size() );
+	}
+
+	roi.clear();
+	for ( size_t i=0; i<coarse.size(); i++ )
+		roi.push_back( Rect( coarse[i].x*s, coarse[i].y*s, coarse[i].width*s, coarse[i].height*s ) & whole );
+
+	if( quadrilateral.size() < roi.size() )
+		quadrilateral.resize( roi.size() );
+
+	green_blob.create( frame.size(), CV_8UC1 );
+	green_blob.setTo( 0 );
+
+	for_each_roi( [&] ( size_t i, size_t worker ){
+		find_roi_quadrilaterals ( Mat(small_green, coarse[i]), scratch[worker], quadrilateral[i], s );
+
+		// The full resolution mask, only in the ROI
+		Mat blob_roi = Mat(green_blob, roi[i]);
+		green_roi ( Mat(frame, roi[i]), blob_roi, scratch[worker] );
+
+		// Back to full resolution, at the center of the small pixels
+		for ( size_t j=0; j<quadrilateral[i].size(); j++ ){
+			Quadrilateral& q = quadrilateral[i][j];
+			for ( size_t k=0; k<q.size(); k++ )
+				q[k] = q[k]*s + Point( (s-1)/2, (s-1)/2 );
+
+			refine_quadrilateral ( blob_roi, q, settings.refine_radius );
+		}
+	});
+
+	gather();
+}
+
+//! Finds the green and the quadrilaterals in the whole frame.
+void Processor::detect ( Mat& frame ){
+	// Find the green
+	find_green( frame, green_blob );
+
+	// Find ROIS
+	roi.clear();
+	find_connected_components ( green_blob, roi );
+	{
+		ScopedTimer timer ( Timing::GROUP );
+		extend_and_group_bounding_rects ( roi, green_blob.size() );
+	}
+
+	if( quadrilateral.size() < roi.size() )
+		quadrilateral.resize( roi.size() );
+
+	for_each_roi( [&] ( size_t i, size_t worker ){
+		find_roi_quadrilaterals ( Mat(green_blob, roi[i]), scratch[worker], quadrilateral[i] );
+	});
+
+	gather();
+}
+
+/** @fn void Processor::find_green ( const Mat& frame, Mat& mask )
+  *
+  * @brief	The mask of best_green(), or a copy of the incremental one:
+  *		`mask` gets the blobs painted, the incremental one must not.
+  *		From the NV12 frame if there is one of this size.
+  */
+void Processor::find_green ( const Mat& frame, Mat& mask ){
+	if( settings.incremental )
+		incremental.update( frame ).copyTo( mask );
+	else if( yuv.data && yuv.cols == frame.cols && yuv.rows == frame.rows * 3 / 2 )
+		best_green_nv12 ( yuv, mask, green_scratch );
+	else
+		best_green ( frame, mask, green_scratch );
+}
+
+//! Gathers the quadrilaterals of every ROI in `found`, in frame coordinates.
+void Processor::gather (){
+	found.clear();
+	for ( size_t i=0; i<roi.size(); i++ )
+		for ( size_t j=0; j<quadrilateral[i].size(); j++ ){
+			Quadrilateral q = quadrilateral[i][j];
+			for ( size_t k=0; k<q.size(); k++ )
+				q[k] += roi[i].tl();
+			found.push_back( q );
+		}
+}
+
+/** @fn void Processor::green_roi ( const Mat& frame_roi, Mat& blob_roi, RoiScratch& scratch )
+  *
+  * @brief	The green of a ROI of the frame, in the same ROI of the
+  *		mask, with its blobs painted with 127. Only the ROI of the
+  *		frame is blurred, as if it was the whole frame.
+  */
+void Processor::green_roi ( const Mat& frame_roi, Mat& blob_roi, RoiScratch& scratch ){
+	best_green ( frame_roi, blob_roi, scratch.green );
+	find_connected_components ( blob_roi, scratch.blobs );
+}
+
+void Processor::find_roi_quadrilaterals ( const Mat& blob_roi, RoiScratch& scratch, vector<Quadrilateral>& quadrilateral, int scale ){
+	Mat contours = grow( scratch.contours, blob_roi.size(), CV_8UC1 );
+	blob_roi.copyTo( contours );
+
+	// Get good quadrilaterals
+	quadrilateral.clear();
+	get_good_quadrilaterals ( contours,  quadrilateral, scratch.quad, scale );
+}
@@ -0,0 +1,107 @@
+/** @file quad_tracker.cpp
+  * @brief carries the quadrilaterals from one frame to the next, so the full detection is not needed every frame.
+  */
+//--INCLUDES--------------------------------------------------
+#include <quad_tracker.hpp>
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+//! Mean of the four points.
+static Point2f center ( Quadrilateral& q ){
+	Point2f c (0, 0);
+	for ( size_t i=0; i<q.size(); i++ ){
+		c.x += q[i].x;
+		c.y += q[i].y;
+	}
+	return c * (1.f / q.size());
+}
+
+/** @fn QuadTracker::QuadTracker ( int interval )
+  *
+  * @param interval	Frames from one full detection to the next. With 1
+  *			or less every frame is a full detection.
+  */
+QuadTracker::QuadTracker ( int interval ) :
+	interval ( max( interval, 1 ) ), since_detection ( 0 ){
+}
+
+/** @fn bool QuadTracker::due () const
+  *
+  * @return	Whether the next frame needs the full detection.
+  */
+bool QuadTracker::due () const {
+	return tracked.empty() || since_detection >= interval;
+}
+
+/** @fn void QuadTracker::windows ( Size size, vector<Rect>& out ) const
+  *
+  * @brief	Where to search every tracked quadrilateral: its bounding
+  *		rectangle grown by TRACK_SEARCH_MARGIN, inside the frame.
+  *		The windows may overlap.
+  */
+void QuadTracker::windows ( Size size, vector<Rect>& out ) const {
+	const Rect frame ( Point(0, 0), size );
+
+	out.clear();
+	for ( size_t i=0; i<tracked.size(); i++ ){
+		Quadrilateral q = tracked[i];
+
+		// Bounding rectangle of the corners
+		Point tl = q[0], br = q[0];
+		for ( size_t k=1; k<q.size(); k++ ){
+			tl.x = min( tl.x, q[k].x );
+			tl.y = min( tl.y, q[k].y );
+			br.x = max( br.x, q[k].x );
+			br.y = max( br.y, q[k].y );
+		}
+
+		Rect window ( tl, br + Point(1, 1) );
+		window.x -= TRACK_SEARCH_MARGIN;
+		window.y -= TRACK_SEARCH_MARGIN;
+		window.width  += 2*TRACK_SEARCH_MARGIN;
+		window.height += 2*TRACK_SEARCH_MARGIN;
+
+		window &= frame;
+		if( window.area() > 0 )
+			out.push_back( window );
+	}
+}
+
+/** @fn bool QuadTracker::found_again ( vector<Quadrilateral>& found ) const
+  *
+  * @param found	Quadrilaterals found in the windows, in frame coordinates.
+  *
+  * @return	Whether every tracked quadrilateral is in `found`. Other
+  *		quadrilaterals in `found` do not matter.
+  */
+bool QuadTracker::found_again ( vector<Quadrilateral>& found ) const {
+	for ( size_t i=0; i<tracked.size(); i++ ){
+		Quadrilateral q = tracked[i];
+		Point2f c = center( q );
+		float area = q.area();
+
+		bool ok = false;
+		for ( size_t j=0; j<found.size() && !ok; j++ ){
+			float ratio = found[j].area() / area;
+			ok = norm( center( found[j] ) - c ) <= TRACK_SEARCH_MARGIN &&
+			     ratio <= TRACK_MAX_AREA_RATIO && ratio >= 1.f / TRACK_MAX_AREA_RATIO;
+		}
+
+		if( !ok )
+			return false;
+	}
+	return true;
+}
+
+/** @fn void QuadTracker::update ( const vector<Quadrilateral>& found, bool detected )
+  *
+  * @brief	The quadrilaterals of this frame become the tracked ones.
+  *
+  * @param detected	Whether they come from the full detection.
+  */
+void QuadTracker::update ( const vector<Quadrilateral>& found, bool detected ){
+	tracked = found;
+	since_detection = detected ? 1 : since_detection + 1;
+}
@@ -0,0 +1,219 @@
+/** @file raw_frames.cpp
+  * @brief container of raw frames, written as they come and replayed from a memory mapping.
+  */
+//--INCLUDES--------------------------------------------------
+#include <raw_frames.hpp>
+
+#include <iostream>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+using namespace cv;
+
+//! `n` rounded up to a whole number of pages.
+static inline uint64_t whole_pages ( uint64_t n ){
+	return ( n + RAW_FRAMES_PAGE - 1 ) / RAW_FRAMES_PAGE * RAW_FRAMES_PAGE;
+}
+
+//! Whether `path` has the extension of the container.
+bool is_raw_frames ( const string& path ){
+	const size_t n = strlen( RAW_FRAMES_EXTENSION );
+	return path.size() > n && path.compare( path.size() - n, n, RAW_FRAMES_EXTENSION ) == 0;
+}
+
+//--RAW_WRITER------------------------------------------------
+
+/** @fn bool RawWriter::open ( const string& path, Size size, int type, double fps )
+  *
+  * @brief	Creates the file, or truncates it, with the header of frames
+  *		of `size` and `type`.
+  *
+  * @return	false, with the reason on cerr, if it could not be written.
+  */
+bool RawWriter::open ( const string& path, Size size, int type, double fps ){
+	close();
+
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, RAW_FRAMES_MAGIC, sizeof(header.magic) );
+	header.width = size.width;
+	header.height = size.height;
+	header.type = type;
+	header.row_bytes = (uint64_t) size.width * CV_ELEM_SIZE( type );
+	header.record_bytes = whole_pages( RAW_FRAMES_INFO + header.row_bytes * size.height );
+	header.fps = fps;
+
+	this->path = path;
+	failed = false;
+
+	file = fopen( path.c_str(), "wb" );
+	if( !file ){
+		cerr << path << ": cannot create" << endl;
+		return false;
+	}
+
+	// The header takes the whole first page
+	padding.assign( RAW_FRAMES_PAGE, 0 );
+	memcpy( &padding[0], &header, sizeof(header) );
+	if( fwrite( &padding[0], 1, padding.size(), file ) != padding.size() ){
+		cerr << path << ": cannot write" << endl;
+		close();
+		return false;
+	}
+	memset( &padding[0], 0, sizeof(header) );
+
+	count = 0;
+	return true;
+}
+
+/** @fn bool RawWriter::write ( const Mat& frame )
+  *
+  * @brief	Appends `frame`, that must have the size and the type of
+  *		open(), row by row.
+  *
+  * A record written in part would put every record after it out of
+  * place, so after the first write that fails nothing else is
+  * written: the file keeps the whole records before it.
+  */
+bool RawWriter::write ( const Mat& frame ){
+	if( !file || failed || frame.cols != header.width || frame.rows != header.height || frame.type() != header.type )
+		return false;
+
+	const int64 now = getTickCount();
+	if( !count )
+		start = now;
+
+	char info[RAW_FRAMES_INFO] = { 0 };
+	RawFrameInfo* i = (RawFrameInfo*) info;
+	i->timestamp = (int64_t) ( ( now - start ) * 1e6 / getTickFrequency() );
+	i->index = count;
+
+	bool ok = fwrite( info, 1, sizeof(info), file ) == sizeof(info);
+	for ( int y = 0; ok && y < frame.rows; y++ )
+		ok = fwrite( frame.ptr<uchar>(y), 1, header.row_bytes, file ) == header.row_bytes;
+
+	const size_t tail = header.record_bytes - RAW_FRAMES_INFO - header.row_bytes * header.height;
+	ok = ok && fwrite( &padding[0], 1, tail, file ) == tail;
+
+	if( !ok ){
+		cerr << path << ": cannot write, no frame after the " << count << " written is kept" << endl;
+		failed = true;
+		return false;
+	}
+
+	count++;
+	return true;
+}
+
+/** @fn bool RawWriter::close ()
+  *
+  * @brief	Writes the number of frames in the header and closes the
+  *		file. A file that was not closed is still read, by its size.
+  *
+  * @return	false, with the reason on cerr, if the header or the last
+  *		frames could not be written, or a write had failed before.
+  */
+bool RawWriter::close (){
+	if( !file )
+		return true;
+
+	header.count = count;
+	bool ok = fseek( file, 0, SEEK_SET ) == 0 &&
+		  fwrite( &header, 1, sizeof(header), file ) == sizeof(header);
+	ok = fclose( file ) == 0 && ok;
+	file = NULL;
+
+	if( !ok )
+		cerr << path << ": cannot write, the file may be incomplete" << endl;
+	return ok && !failed;
+}
+
+//--RAW_READER------------------------------------------------
+
+/** @fn bool RawReader::open ( const string& path )
+  *
+  * @brief	Maps the whole file. Only the whole records count, so a file
+  *		that is still being written, or was cut, can be read too.
+  *
+  * @return	false, with the reason on cerr, if it is not a container.
+  */
+bool RawReader::open ( const string& path ){
+	close();
+
+	int fd = ::open( path.c_str(), O_RDONLY );
+	if( fd < 0 ){
+		cerr << path << ": cannot open" << endl;
+		return false;
+	}
+
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || (size_t) st.st_size < RAW_FRAMES_PAGE ){
+		cerr << path << ": not a container of raw frames" << endl;
+		::close( fd );
+		return false;
+	}
+
+	// Private: what the Processor writes in the frames stays in this process
+	length = st.st_size;
+	void* map = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	::close( fd );
+	if( map == MAP_FAILED ){
+		cerr << path << ": cannot map" << endl;
+		length = 0;
+		return false;
+	}
+	base = (uchar*) map;
+
+	const RawFramesHeader& h = header();
+	if( memcmp( h.magic, RAW_FRAMES_MAGIC, sizeof(h.magic) ) != 0 || h.width <= 0 || h.height <= 0 ||
+	    h.row_bytes != (uint64_t) h.width * CV_ELEM_SIZE( h.type ) ||
+	    h.record_bytes < RAW_FRAMES_INFO + h.row_bytes * h.height || h.record_bytes % RAW_FRAMES_PAGE ){
+		cerr << path << ": not a container of raw frames" << endl;
+		close();
+		return false;
+	}
+
+	n = ( length - RAW_FRAMES_PAGE ) / h.record_bytes;
+	released = 0;
+	madvise( base, length, MADV_SEQUENTIAL );
+	return true;
+}
+
+void RawReader::close (){
+	if( base )
+		munmap( base, length );
+	base = NULL;
+	length = n = released = 0;
+}
+
+/** @fn Mat RawReader::frame ( size_t i ) const
+  *
+  * @return	The frame `i`, over the mapping, valid until close(). What
+  *		is written in it is undone by release().
+  */
+Mat RawReader::frame ( size_t i ) const {
+	CV_Assert( i < n );
+
+	uchar* pixels = base + RAW_FRAMES_PAGE + i * header().record_bytes + RAW_FRAMES_INFO;
+	return Mat( header().height, header().width, header().type, pixels, header().row_bytes );
+}
+
+/** @fn void RawReader::release ( size_t before )
+  *
+  * @brief	Gives back to the system the pages of the frames before
+  *		`before`, the changed ones too: they would be the file
+  *		again if read, and the memory of a long replay stays bounded.
+  */
+void RawReader::release ( size_t before ){
+	before = min( before, n );
+	if( before <= released )
+		return;
+
+	const uint64_t record = header().record_bytes;
+	madvise( base + RAW_FRAMES_PAGE + released * record, ( before - released ) * record, MADV_DONTNEED );
+	released = before;
+}
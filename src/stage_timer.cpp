@@ -0,0 +1,154 @@
+/** @file stage_timer.cpp
+  * @brief latency histograms of every stage of the pipeline.
+  */
+//--INCLUDES--------------------------------------------------
+#include <stage_timer.hpp>
+
+#include <fstream>
+#include <mutex>
+#include <algorithm>
+
+//--MACROS----------------------------------------------------
+#define SUB_BUCKETS	( 1 << LATENCY_SUB_BITS )
+#define MAX_NS		( ( (uint64_t) 1 << LATENCY_MAX_BITS ) - 1 )
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+
+LatencyHistogram::LatencyHistogram () : total ( 0 ), sum ( 0 ), maximum ( 0 ){
+	for ( int i = 0; i < LATENCY_BUCKETS; i++ )
+		buckets[i] = 0;
+}
+
+/** @fn int LatencyHistogram::index ( uint64_t ns )
+  *
+  * @brief	Bucket of `ns`: the values below SUB_BUCKETS have one bucket
+  *		each, and every power of two above them has SUB_BUCKETS.
+  */
+int LatencyHistogram::index ( uint64_t ns ){
+	ns = min( ns, MAX_NS );
+	if( ns < SUB_BUCKETS )
+		return ns;
+
+	int shift = 63 - __builtin_clzll( ns ) - LATENCY_SUB_BITS;
+	return ( (shift + 1) << LATENCY_SUB_BITS ) + (int) ( (ns >> shift) - SUB_BUCKETS );
+}
+
+//! Greatest value that goes in the bucket `index`.
+uint64_t LatencyHistogram::highest ( int index ){
+	if( index < SUB_BUCKETS )
+		return index;
+
+	int shift = ( index >> LATENCY_SUB_BITS ) - 1;
+	uint64_t sub = SUB_BUCKETS + ( index & (SUB_BUCKETS - 1) );
+	return ( (sub + 1) << shift ) - 1;
+}
+
+void LatencyHistogram::add ( uint64_t ns ){
+	buckets[ index( ns ) ].fetch_add( 1, memory_order_relaxed );
+	total.fetch_add( 1, memory_order_relaxed );
+	sum.fetch_add( ns, memory_order_relaxed );
+
+	uint64_t m = maximum.load( memory_order_relaxed );
+	while( ns > m && !maximum.compare_exchange_weak( m, ns, memory_order_relaxed ) );
+}
+
+/** @fn uint64_t LatencyHistogram::percentile ( double p ) const
+  *
+  * @param p	From 0 to 100.
+  *
+  * @return	The greatest value of the bucket where the percentile falls,
+  *		never more than the maximum. 0 with no values.
+  */
+uint64_t LatencyHistogram::percentile ( double p ) const {
+	uint64_t n = count();
+	if( !n )
+		return 0;
+
+	// Rank of the value, from 1 to n
+	uint64_t rank = std::max( (uint64_t) ( p / 100. * n + 0.5 ), (uint64_t) 1 );
+
+	uint64_t seen = 0;
+	for ( int i = 0; i < LATENCY_BUCKETS; i++ ){
+		seen += buckets[i].load( memory_order_relaxed );
+		if( seen >= rank )
+			return min( highest( i ), max() );
+	}
+	return max();
+}
+
+//--TIMING----------------------------------------------------
+
+namespace Timing{
+	bool enabled = false;
+
+	static LatencyHistogram histogram[N_STAGES];
+
+	static const char* names[N_STAGES] = {
+		"capture", "convert", "downscale", "frame_diff", "classify", "blur_dilate", "label", "group",
+		"contours", "quad_fit", "warp_composite", "process", "output", "write", "display"
+	};
+
+	const char* name ( Stage stage ){
+		return names[stage];
+	}
+
+	void record ( Stage stage, uint64_t ns ){
+		histogram[stage].add( ns );
+	}
+
+	/** @fn bool dump ( const string& path )
+	  *
+	  * @brief	Writes count, mean, p50, p95, p99 and maximum of every
+	  *		stage that ran, in microseconds: JSON if `path` ends
+	  *		with .json, CSV otherwise. The file is replaced.
+	  *
+	  *		Safe from any thread: one writes at a time.
+	  *
+	  * @return	Whether the file could be written.
+	  */
+	bool dump ( const string& path ){
+		static mutex lock;
+		lock_guard<mutex> guard ( lock );
+
+		ofstream out ( path.c_str(), ios::trunc );
+		if( !out )
+			return false;
+
+		const bool json = path.size() >= 5 && path.compare( path.size() - 5, 5, ".json" ) == 0;
+		out.setf( ios::fixed );
+		out.precision( 3 );
+
+		if( json )
+			out << "{" << endl;
+		else
+			out << "stage,count,mean_us,p50_us,p95_us,p99_us,max_us" << endl;
+
+		bool first = true;
+		for ( int s = 0; s < N_STAGES; s++ ){
+			const LatencyHistogram& h = histogram[s];
+			if( !h.count() )
+				continue;
+
+			if( json ){
+				out	<< ( first ? "" : ",\n" ) << "\t\"" << names[s] << "\": {"
+					<< "\"count\": " << h.count()
+					<< ", \"mean_us\": " << h.mean() / 1e3
+					<< ", \"p50_us\": " << h.percentile( 50 ) / 1e3
+					<< ", \"p95_us\": " << h.percentile( 95 ) / 1e3
+					<< ", \"p99_us\": " << h.percentile( 99 ) / 1e3
+					<< ", \"max_us\": " << h.max() / 1e3 << "}";
+			}else{
+				out	<< names[s] << "," << h.count() << "," << h.mean() / 1e3 << ","
+					<< h.percentile( 50 ) / 1e3 << "," << h.percentile( 95 ) / 1e3 << ","
+					<< h.percentile( 99 ) / 1e3 << "," << h.max() / 1e3 << endl;
+			}
+			first = false;
+		}
+
+		if( json )
+			out << endl << "}" << endl;
+
+		return out.good();
+	}
+};
@@ -0,0 +1,209 @@
+/** @file thread_pool.cpp
+  * @brief fixed set of worker threads for the data parallel parts of the pipeline.
+  */
+//--INCLUDES--------------------------------------------------
+#include <thread_pool.hpp>
+
+//--NAMESPACES------------------------------------------------
+using namespace std;
+
+/** @struct ThreadPool::Loop
+  *
+  * Shared by everybody working on one parallel_for(). The tasks may still
+  * point to it after the caller returned, so it counts its users and is
+  * only reused when there is none left.
+  */
+struct ThreadPool::Loop {
+	atomic<size_t> next;	// next iteration to take
+	size_t n;
+	const function<void (size_t, size_t)>* body;
+
+	size_t finished;
+	mutex lock;
+	condition_variable all_done;
+
+	atomic<size_t> users;	// the caller and the tasks not done yet
+};
+
+/** @fn ThreadPool::ThreadPool ( size_t n_workers )
+  *
+  * @param n_workers	Number of threads besides the caller, may be zero.
+  */
+ThreadPool::ThreadPool ( size_t n_workers ) :
+	queues ( new Queue[ n_workers ] ), n_queues ( n_workers ), pending ( 0 ), next_queue ( 0 ), stopping ( false ){
+
+	for ( size_t i = 0; i < n_workers; i++ )
+		workers.push_back( thread( &ThreadPool::work, this, i ) );
+}
+
+ThreadPool::~ThreadPool (){
+	{
+		lock_guard<mutex> guard ( sleep_lock );
+		stopping = true;
+	}
+	wakeup.notify_all();
+
+	for ( size_t i = 0; i < workers.size(); i++ )
+		workers[i].join();
+}
+
+//--QUEUE-----------------------------------------------------
+
+void ThreadPool::Queue::push_back ( Loop* loop ){
+	// Full: a bigger ring, in order from the first
+	if( count == ring.size() ){
+		vector<Loop*> bigger ( max( ring.size() * 2, (size_t) 8 ) );
+		for ( size_t i = 0; i < count; i++ )
+			bigger[i] = ring[ (first + i) % ring.size() ];
+		ring.swap( bigger );
+		first = 0;
+	}
+
+	ring[ (first + count) % ring.size() ] = loop;
+	count++;
+}
+
+ThreadPool::Loop* ThreadPool::Queue::pop_front (){
+	Loop* loop = ring[first];
+	first = ( first + 1 ) % ring.size();
+	count--;
+	return loop;
+}
+
+ThreadPool::Loop* ThreadPool::Queue::pop_back (){
+	count--;
+	return ring[ (first + count) % ring.size() ];
+}
+
+//--POOL------------------------------------------------------
+
+/** @fn ThreadPool::Loop* ThreadPool::free_loop ( size_t users )
+  *
+  * @return	A Loop nobody used, now with `users` users. New only if all
+  *		of them are in use.
+  */
+ThreadPool::Loop* ThreadPool::free_loop ( size_t users ){
+	lock_guard<mutex> guard ( loops_lock );
+
+	Loop* loop = NULL;
+	for ( size_t i = 0; i < loops.size() && !loop; i++ )
+		if( loops[i]->users.load( memory_order_acquire ) == 0 )
+			loop = loops[i].get();
+
+	if( !loop ){
+		loops.push_back( unique_ptr<Loop>( new Loop ) );
+		loop = loops.back().get();
+	}
+
+	loop->users.store( users, memory_order_relaxed );
+	return loop;
+}
+
+/** @fn ThreadPool::Loop* ThreadPool::take ( size_t worker )
+  *
+  * @return	The first task of the own queue of `worker` or, if it is
+  *		empty, the last one of another queue. NULL if there is none.
+  */
+ThreadPool::Loop* ThreadPool::take ( size_t worker ){
+	for ( size_t k = 0; k < n_queues; k++ ){
+		Queue& queue = queues[ (worker + k) % n_queues ];
+		lock_guard<mutex> guard ( queue.lock );
+		if( !queue.count )
+			continue;
+
+		pending--;
+		return k == 0 ? queue.pop_front() : queue.pop_back();
+	}
+	return NULL;
+}
+
+/** @fn void ThreadPool::help ( Loop* loop, size_t worker )
+  *
+  * @brief	Runs iterations of `loop` until there is none left to take,
+  *		and lets it go.
+  */
+void ThreadPool::help ( Loop* loop, size_t worker ){
+	const size_t n = loop->n;
+
+	size_t done = 0;
+	for ( size_t i; (i = loop->next++) < n; done++ )
+		(*loop->body)( i, worker );
+
+	if( done ){
+		lock_guard<mutex> guard ( loop->lock );
+		loop->finished += done;
+		if( loop->finished == n )
+			loop->all_done.notify_all();
+	}
+
+	loop->users.fetch_sub( 1, memory_order_release );
+}
+
+/** @fn void ThreadPool::work ( size_t worker )
+  *
+  * @brief	Loop of every worker: runs the tasks until the pool is
+  *		destroyed, and sleeps while there is none in any queue.
+  */
+void ThreadPool::work ( size_t worker ){
+	for(;;){
+		Loop* loop = take( worker );
+		if( loop ){
+			help( loop, worker );
+			continue;
+		}
+
+		unique_lock<mutex> guard ( sleep_lock );
+		while( !stopping && pending == 0 )
+			wakeup.wait( guard );
+
+		if( stopping && pending == 0 )
+			return;
+	}
+}
+
+/** @fn void ThreadPool::parallel_for ( size_t n, const function<void (size_t, size_t)>& body )
+  *
+  * @brief	Runs body(i, worker) for every i in [0, n) and returns when
+  *		all of them are done. Iterations are taken in order, but may
+  *		finish in any order.
+  */
+void ThreadPool::parallel_for ( size_t n, const function<void (size_t, size_t)>& body ){
+	if( n == 0 )
+		return;
+
+	// One helper per queue, as many as there are iterations for them
+	size_t helpers = min( n - 1, workers.size() );
+
+	// The helpers, the help of the caller and the caller itself
+	Loop* loop = free_loop( helpers + 2 );
+	loop->next = 0;
+	loop->n = n;
+	loop->body = &body;
+	loop->finished = 0;
+
+	if( helpers ){
+		size_t first = next_queue.fetch_add( helpers );
+		for ( size_t i = 0; i < helpers; i++ ){
+			Queue& queue = queues[ (first + i) % n_queues ];
+			lock_guard<mutex> guard ( queue.lock );
+			queue.push_back( loop );
+			pending++;
+		}
+
+		// A worker that saw no pending task is asleep by now, or will see them
+		{
+			lock_guard<mutex> guard ( sleep_lock );
+		}
+		wakeup.notify_all();
+	}
+
+	help( loop, workers.size() );
+
+	{
+		unique_lock<mutex> guard ( loop->lock );
+		while( loop->finished < n )
+			loop->all_done.wait( guard );
+	}
+
+	loop->users.fetch_sub( 1, memory_order_release );
+}